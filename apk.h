@@ -0,0 +1,795 @@
+#ifndef APK_H
+#define APK_H
+
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <string>
+#include <regex>
+#include <vector>
+
+#include "types.h"
+#include "baseline.h"
+#include "dex.h"
+#include "filter.h"
+#include "mapping.h"
+#include "rules.h"
+#include "zip.h"
+#include "log.h"
+
+struct DexFile
+{
+    DexHeader header;
+    DexStringId *stringPool;
+    DexTypeId *typePool;
+    DexClassDef *classes;
+    DexFieldId *fields;
+    DexMethodId *methods;
+    DexProtoId *protos;
+    const u1 *data;
+    size_t dataCapacity;
+    std::string tag;
+
+    // 方法原型描述符 "(I)V"，只有启用了方法相关的规则时才生成，生成后 DexFile 不能再被拷贝或移动
+    std::vector<char> protoPool;
+    std::vector<u4> protoOffsets;
+
+    std::unordered_map<std::string, DexClassDef *> nameToClassMap;
+
+    [[nodiscard]]
+    const char *getTypeName(u2 indexToTypePool) const noexcept
+    {
+        auto &typeId = typePool[indexToTypePool];
+        auto &string = stringPool[typeId.descriptorIdx];
+        auto buff = data + string.stringDataOff;
+        return (char *) (buff + 1);
+    }
+
+    [[nodiscard]]
+    const char *getStringAt(u4 index) const noexcept
+    {
+        auto &string = stringPool[index];
+        auto buff = data + string.stringDataOff;
+        return (char *) (buff + 1);
+    }
+
+    int readFrom(BytesInput &file) noexcept
+    {
+        file >> header;
+        if (memcmp((char *) header.magic, DexHeader::MAGIC, sizeof(header.magic)) != 0) {
+            printf("invalid magic\n");
+            return -1;
+        }
+        if (header.endianTag != 0x12345678) {
+            printf("invalid endian\n");
+            return -1;
+        }
+
+        data = (u1 *) file.data();
+        dataCapacity = file.length();
+        stringPool = (DexStringId *) (data + header.stringIdsOff);
+        typePool = (DexTypeId *) (data + header.typeIdsOff);
+        classes = (DexClassDef *) (data + header.classDefsOff);
+        fields = (DexFieldId *) (data + header.fieldIdsOff);
+        methods = (DexMethodId *) (data + header.methodIdsOff);
+        protos = (DexProtoId *) (data + header.protoIdsOff);
+
+        for (size_t i = 0, n = header.classDefsSize; i < n; ++i) {
+            const char *name = getTypeName(classes[i].classIdx);
+            nameToClassMap[name] = &classes[i];
+        }
+
+        return 0;
+    }
+
+    [[nodiscard]]
+    DexClassDef *findClassByName(const char *name) const noexcept
+    {
+        const auto &it = nameToClassMap.find(name);
+        return it == nameToClassMap.end() ? nullptr : it->second;
+    }
+
+    [[nodiscard]]
+    const DexTypeList *getTypeList(u4 offset) const noexcept
+    {
+        return offset == 0 ? nullptr : (const DexTypeList *) (data + offset);
+    }
+
+    void prepareProtoStrings() noexcept
+    {
+        if (!protoOffsets.empty() || header.protoIdsSize == 0) {
+            return;
+        }
+        protoOffsets.resize(header.protoIdsSize);
+        for (size_t i = 0, n = header.protoIdsSize; i < n; ++i) {
+            protoOffsets[i] = (u4) protoPool.size();
+            protoPool.push_back('(');
+            if (auto params = getTypeList(protos[i].parametersOff); params != nullptr) {
+                for (u4 j = 0; j < params->size; ++j) {
+                    auto name = getTypeName(params->list[j].typeIdx);
+                    protoPool.insert(protoPool.end(), name, name + strlen(name));
+                }
+            }
+            protoPool.push_back(')');
+            auto returnType = getTypeName(protos[i].returnTypeIdx);
+            protoPool.insert(protoPool.end(), returnType, returnType + strlen(returnType) + 1);
+        }
+    }
+
+    [[nodiscard]]
+    const char *getProtoString(u2 indexToProtoPool) const noexcept
+    {
+        return protoPool.data() + protoOffsets[indexToProtoPool];
+    }
+};
+
+struct DexField {
+
+    u4 fieldIdx;    /* index to a field_id_item */
+    u4 accessFlags;
+};
+
+struct DexMethod {
+    u4 methodIdx;    /* index to a method_id_item */
+    u4 accessFlags;
+    u4 codeOff;      /* file offset to a code_item */
+};
+
+struct DexClassData {
+    u4 staticFieldsSize;
+    u4 instanceFieldsSize;
+    u4 directMethodsSize;
+    u4 virtualMethodsSize;
+
+    std::vector<DexField> staticFields;
+    std::vector<DexField> instanceFields;
+    std::vector<DexMethod> directMethods;
+    std::vector<DexMethod> virtualMethods;
+
+    static u4 readAsULEB128(BytesInput &in) noexcept
+    {
+        u4 result = 0, count = 0;
+        u1 cur;
+        do {
+            in >> cur;
+            result |= (cur & 0x7f) << ((count ++) * 7);
+        } while ((cur & 0x80) == 128 && count < 5);
+        return result;
+    }
+
+    static void readFields(BytesInput &in, std::vector<DexField> *fields, u4 size) noexcept
+    {
+        u4 off = 0;
+        fields->resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            auto fieldIdx = readAsULEB128(in);
+            auto accessFlag = readAsULEB128(in);
+            (*fields)[i] = {
+                    off + fieldIdx,
+                    accessFlag,
+            };
+            off += fieldIdx;
+        }
+    }
+
+    static void readMethods(BytesInput &in, std::vector<DexMethod> *methods, u4 size) noexcept
+    {
+        u4 off = 0;
+        methods->resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            auto methodIdx = readAsULEB128(in);
+            auto accessFlag = readAsULEB128(in);
+            auto codeOff = readAsULEB128(in);
+            (*methods)[i] = {
+                    off + methodIdx,
+                    accessFlag,
+                    codeOff,
+            };
+            off += methodIdx;
+        }
+    }
+
+    /**
+     * @param withMethods 不需要方法时只跳过，不保存
+     */
+    int readFrom(BytesInput &in, bool withMethods = false) noexcept
+    {
+        staticFieldsSize = readAsULEB128(in);
+        instanceFieldsSize = readAsULEB128(in);
+        directMethodsSize = readAsULEB128(in);
+        virtualMethodsSize = readAsULEB128(in);
+
+        readFields(in, &staticFields, staticFieldsSize);
+        readFields(in, &instanceFields, instanceFieldsSize);
+        if (withMethods) {
+            readMethods(in, &directMethods, directMethodsSize);
+            readMethods(in, &virtualMethods, virtualMethodsSize);
+        }
+        return 0;
+    }
+};
+
+struct ScanOptions
+{
+    const ClassFilter *filter = nullptr;    // 只报告被过滤器接受的类，nullptr 表示全部报告
+    const Baseline *baseline = nullptr;     // 已知问题，产生时直接丢掉
+    const ProguardMapping *mapping = nullptr;   // 有混淆时 baseline 里记录的是还原后的名字
+    bool failFast = false;                  // 找到第一个 (不在 baseline 里的) 问题就停止扫描
+    std::vector<const HierarchyRule *> rules;   // 为空时只启用默认规则 (field-shadowing)
+};
+
+class ApkFile
+{
+private:
+    using Buffer = std::vector<u1>;
+    std::vector<Buffer> mBufferVec;
+    std::vector<DexFile> mDexVec;
+
+    std::unordered_map<DexClassDef*, ResolvedClass> mResolvedClassMap;
+    std::unordered_map<const DexClassDef*, std::string> mDeobfuscatedNameMap;
+
+    std::pair<DexFile*, DexClassDef *> findClassByName(const char *name) noexcept
+    {
+        DexFile *superDex = nullptr;
+        DexClassDef *superClassDef = nullptr;
+
+        for (auto &dexIt : mDexVec) {
+            auto tmp = dexIt.findClassByName(name);
+            if (tmp != nullptr) {
+                superDex = &dexIt;
+                superClassDef = tmp;
+                break;
+            }
+        }
+        return std::make_pair(superDex, superClassDef);
+    }
+
+    static void sortTable(MemberTable *table) noexcept
+    {
+        std::sort(table->begin(), table->end(), [](const auto &p, const auto &q) {
+            return ResolvedMember::compare(p, q) < 0;
+        });
+    }
+
+    static void mergeTable(MemberTable *table, const MemberTable &other) noexcept
+    {
+        if (other.empty()) {
+            return;
+        }
+        auto middle = table->insert(table->end(), other.begin(), other.end());
+        std::inplace_merge(table->begin(), middle, table->end(), [](const auto &p, const auto &q) {
+            return ResolvedMember::compare(p, q) < 0;
+        });
+    }
+
+    static void collectFields(DexFile &dex, DexClassDef &classDef, const std::vector<DexField> &fields,
+                              MemberTable *table) noexcept
+    {
+        for (const auto &dexField : fields) {
+            u4 whiteList = Modifier::ACC_PRIVATE | Modifier::ACC_SYNTHETIC;
+            if ((whiteList & dexField.accessFlags) != 0) {
+                continue;
+            }
+
+            const auto &fieldId = dex.fields[dexField.fieldIdx];
+            table->push_back({
+                    .accessFlag = dexField.accessFlags,
+                    .name = dex.getStringAt(fieldId.nameIdx),
+                    .type = dex.getTypeName(fieldId.typeIdx),
+                    .declaredClassName = dex.getTypeName(classDef.classIdx),
+            });
+        }
+        sortTable(table);
+    }
+
+    static void collectMethods(DexFile &dex, DexClassDef &classDef, const std::vector<DexMethod> &methods,
+                               MemberTable *table) noexcept
+    {
+        for (const auto &dexMethod : methods) {
+            u4 whiteList = Modifier::ACC_PRIVATE | Modifier::ACC_SYNTHETIC | Modifier::ACC_CONSTRUCTOR;
+            if ((whiteList & dexMethod.accessFlags) != 0) {
+                continue;
+            }
+
+            const auto &methodId = dex.methods[dexMethod.methodIdx];
+            table->push_back({
+                    .accessFlag = dexMethod.accessFlags,
+                    .name = dex.getStringAt(methodId.nameIdx),
+                    .type = dex.getProtoString(methodId.protoIdx),
+                    .declaredClassName = dex.getTypeName(classDef.classIdx),
+            });
+        }
+    }
+
+    /**
+     * 生成类自身的成员表：非私有、非合成的实例字段，以及规则需要时的静态字段和方法
+     */
+    static void generateMemberTables(DexFile &dex, DexClassDef &classDef, u4 needs,
+                                     MemberTable *fields, MemberTable *staticFields, MemberTable *methods) noexcept
+    {
+        // 如果偏移量为 0，则说明这个类没有这一项数据（比如接口）
+        if (classDef.classDataOff == 0) {
+            return;
+        }
+
+        BytesInput input(dex.data, dex.dataCapacity);
+        input.seek(classDef.classDataOff);
+        DexClassData dexClassData {};
+        dexClassData.readFrom(input, (needs & HierarchyRule::NEED_METHODS) != 0);
+
+        collectFields(dex, classDef, dexClassData.instanceFields, fields);
+        if ((needs & HierarchyRule::NEED_INTERFACES) != 0) {
+            collectFields(dex, classDef, dexClassData.staticFields, staticFields);
+        }
+        if ((needs & HierarchyRule::NEED_METHODS) != 0) {
+            collectMethods(dex, classDef, dexClassData.directMethods, methods);
+            collectMethods(dex, classDef, dexClassData.virtualMethods, methods);
+            sortTable(methods);
+        }
+    }
+
+    static u4 needsOf(const std::vector<const HierarchyRule *> &rules) noexcept
+    {
+        u4 needs = 0;
+        for (auto rule : rules) {
+            needs |= rule->needs();
+        }
+        return needs;
+    }
+
+    /**
+     * 有 mapping 时过滤器按还原后的类名匹配，--include 写的是源码里的包名。
+     * scanAll 和 resolveClass 都会判断同一个类，还原后的名字按类缓存，一次扫描内只算一遍
+     */
+    bool acceptClass(const DexFile &dex, const DexClassDef &classDef, const ScanOptions &options) noexcept
+    {
+        if (options.filter == nullptr) {
+            return true;
+        }
+        const char *className = dex.getTypeName(classDef.classIdx);
+        if (options.mapping == nullptr) {
+            return options.filter->accept(className);
+        }
+        auto it = mDeobfuscatedNameMap.find(&classDef);
+        if (it == mDeobfuscatedNameMap.end()) {
+            it = mDeobfuscatedNameMap.emplace(&classDef, options.mapping->deobfuscateType(className)).first;
+        }
+        return options.filter->accept(it->second.c_str());
+    }
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "misc-no-recursion"
+    void resolveClass(DexFile &dex, DexClassDef &classDef, const ScanOptions &options,
+                      const std::vector<const HierarchyRule *> &rules, u4 needs,
+                      std::vector<ScanResult> *outVec) noexcept
+    {
+        if (mResolvedClassMap.find(&classDef) != mResolvedClassMap.end()) {
+            return;
+        }
+        const char *className = dex.getTypeName(classDef.classIdx);
+        LOGD("for class '%s' in dex '%s'\n", className, dex.tag.c_str());
+
+        // 先保证父类能正常解析完成
+        const char *superClassName = dex.getTypeName(classDef.superclassIdx);
+        auto [superDex, superClassDef] = findClassByName(superClassName);
+        if (superDex != nullptr && superClassDef != nullptr) {
+            resolveClass(*superDex, *superClassDef, options, rules, needs, outVec);
+            if (options.failFast && !outVec->empty()) {
+                return;
+            }
+        }
+        const ResolvedClass *super = superClassDef == nullptr ? nullptr : &mResolvedClassMap[superClassDef];
+
+        // 遍历所有的字段/方法，将私有/合成的排除，放进 table 里
+        ResolvedClass resolved;
+        MemberTable fields, staticFields, methods;
+        generateMemberTables(dex, classDef, needs, &fields, &staticFields, &methods);
+
+        // 实现的接口里的常量：父类的，加上每个直接实现的接口自身的和它继承的
+        if ((needs & HierarchyRule::NEED_INTERFACES) != 0) {
+            if (super != nullptr) {
+                resolved.interfaceConstants = super->interfaceConstants;
+            }
+            auto interfaces = dex.getTypeList(classDef.interfacesOff);
+            for (u4 i = 0, n = interfaces == nullptr ? 0 : interfaces->size; i < n; ++i) {
+                auto [ifaceDex, ifaceDef] = findClassByName(dex.getTypeName(interfaces->list[i].typeIdx));
+                if (ifaceDef == nullptr) {
+                    continue;
+                }
+                resolveClass(*ifaceDex, *ifaceDef, options, rules, needs, outVec);
+                if (options.failFast && !outVec->empty()) {
+                    return;
+                }
+                const auto &iface = mResolvedClassMap[ifaceDef];
+                mergeTable(&resolved.interfaceConstants, iface.staticFields);
+                mergeTable(&resolved.interfaceConstants, iface.interfaceConstants);
+            }
+        }
+
+        // 所有启用的规则在这里一起检查，被过滤掉的类只是作为父类参与解析，本身不报告
+        if (acceptClass(dex, classDef, options)) {
+            ClassContext ctx = {
+                    .className = className,
+                    .ownFields = fields,
+                    .ownStaticFields = staticFields,
+                    .ownMethods = methods,
+                    .interfaceConstants = resolved.interfaceConstants,
+                    .super = super,
+            };
+            std::vector<ScanResult> candidates;
+            for (auto rule : rules) {
+                rule->check(ctx, &candidates);
+            }
+            for (const auto &it : candidates) {
+                if (!isSuppressed(it, options.baseline, options.mapping)) {
+                    outVec->push_back(it);
+                    if (options.failFast) return;
+                }
+            }
+        }
+
+        // 合并父类的成员表，留给子类使用
+        resolved.fields = std::move(fields);
+        resolved.methods = std::move(methods);
+        resolved.staticFields = std::move(staticFields);
+        if (super != nullptr) {
+            mergeTable(&resolved.fields, super->fields);
+            mergeTable(&resolved.methods, super->methods);
+        }
+        mResolvedClassMap[&classDef] = std::move(resolved);
+    }
+#pragma clang diagnostic pop
+
+    static bool startsWith(const char *s, const char *prefix) noexcept
+    {
+        return strncmp(s, prefix, strlen(prefix)) == 0;
+    }
+
+    int addDex(Buffer &buffer, const std::string &tag) noexcept
+    {
+        BytesInput input(buffer.data(), buffer.size());
+        DexFile dexFile {};
+        if (dexFile.readFrom(input) == -1) {
+            LOGE("entry '%s' is NOT a .dex file\n", tag.c_str());
+            return -1;
+        }
+        dexFile.tag = tag;
+
+        // .apks 里的 standalones/*.apk 或者 splits 里的多个 base-master 变体各自带着完整的 dex，
+        // 同一个 dex 只保留第一份，否则每个类都会被加载多次，每个问题也会被报告多次
+        for (const auto &it : mDexVec) {
+            if (memcmp(it.header.signature, dexFile.header.signature, DexHeader::kSHA1DigestLen) == 0) {
+                LOGD("entry '%s' is the same dex as '%s', skip\n", tag.c_str(), it.tag.c_str());
+                Buffer().swap(buffer);
+                return 0;
+            }
+        }
+        mDexVec.push_back(dexFile);
+        return 0;
+    }
+
+    /**
+     * 一个 zip 里的所有 dex 一起读取，读完一个就交给解压线程
+     */
+    int openDexes(ZipFile &zipFile, const std::vector<size_t> &indexes, const std::string &prefix) noexcept
+    {
+        std::vector<const ZipEntry *> entries;
+        std::vector<void *> buffs;
+        size_t first = mBufferVec.size();
+        for (auto index : indexes) {
+            auto e = zipFile.entryAt(index);
+            LOGD("unzip entry '%s%s' at index '%zu', size = '%llu'\n",
+                 prefix.c_str(), e->name, index, (unsigned long long) e->unCompressedSize);
+            entries.push_back(e);
+            buffs.push_back(mBufferVec.emplace_back(e->unCompressedSize).data());
+        }
+
+        std::vector<int> results;
+        zipFile.uncompress(entries, buffs, &results);
+        for (size_t i = 0; i < indexes.size(); ++i) {
+            if (results[i] == -1) {
+                LOGE("failed to unzip entry '%s%s' at index '%zu', ignore ...\n",
+                     prefix.c_str(), entries[i]->name, indexes[i]);
+                return -1;
+            }
+            if (addDex(mBufferVec[first + i], prefix + entries[i]->name) == -1) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    static bool isDexEntry(const char *name) noexcept
+    {
+        static const std::regex dexReg("^([^/]+/dex/)?classes\\d*\\.dex$");
+        return name != nullptr && std::regex_match(name, dexReg);
+    }
+
+    static bool isApkEntry(const char *name) noexcept
+    {
+        static const std::regex apkReg("^[^/]+/[^/]+\\.apk$|^[^/]+\\.apk$");
+        return name != nullptr && std::regex_match(name, apkReg);
+    }
+
+    /**
+     * 打开嵌套在 .apks 里的 apk。未压缩存储的直接按偏移量读外层 zip，压缩过的先解压到内存
+     */
+    int openNested(ZipFile &zipFile, size_t index, const std::string &prefix) noexcept
+    {
+        auto e = zipFile.entryAt(index);
+        std::string tag = prefix + e->name + "!";
+        LOGD("open nested zip '%s'\n", tag.c_str());
+
+        ZipFile inner;
+        Buffer buffer;
+        if (e->method == COMPRESS_STORE && (e->flag & FLAG_ENCRYPTED) == 0) {
+            if (inner.open(zipFile, e->bytesOffset, e->unCompressedSize) == -1) {
+                LOGE("failed to open nested zip '%s'\n", tag.c_str());
+                return -1;
+            }
+            return openZip(inner, tag);
+        }
+
+        buffer.resize(e->unCompressedSize);
+        if (zipFile.uncompress(e, buffer.data()) == -1 || inner.open(buffer.data(), buffer.size()) == -1) {
+            LOGE("failed to open nested zip '%s'\n", tag.c_str());
+            return -1;
+        }
+        return openZip(inner, tag);
+    }
+
+    int openZip(ZipFile &zipFile, const std::string &prefix) noexcept
+    {
+        // 本身带 dex 的是 apk/aab，里面的 .apk (比如插件) 不属于它，只有 .apks 这种容器才往下找一层；
+        // .apks 同时带了 splits 和 standalones 时只取 splits，否则类会重复
+        bool isContainer = prefix.empty();
+        bool hasSplits = false;
+        for (size_t i = 0, n = zipFile.size(); i < n; ++i) {
+            auto e = zipFile.entryAt(i);
+            if (isDexEntry(e->name)) isContainer = false;
+            if (isApkEntry(e->name) && startsWith(e->name, "splits/")) hasSplits = true;
+        }
+
+        std::vector<size_t> dexIndexes;
+        for (size_t i = 0, n = zipFile.size(); i < n; ++i) {
+            auto e = zipFile.entryAt(i);
+            if (isDexEntry(e->name)) {
+                dexIndexes.push_back(i);
+            }
+            else if (isContainer && isApkEntry(e->name)
+                     && (!hasSplits || startsWith(e->name, "splits/"))) {
+                if (openNested(zipFile, i, prefix) == -1) {
+                    return -1;
+                }
+            }
+        }
+        return dexIndexes.empty() ? 0 : openDexes(zipFile, dexIndexes, prefix);
+    }
+
+public:
+    explicit ApkFile() noexcept = default;
+
+    /**
+     * 结果是否在 baseline 里。有 mapping 时按还原后的名字比较，
+     * 因为混淆后的名字每次构建都可能变化；只有真正产生的结果才需要还原
+     */
+    static bool isSuppressed(const ScanResult &result, const Baseline *baseline,
+                             const ProguardMapping *mapping) noexcept
+    {
+        if (baseline == nullptr || baseline->empty()) {
+            return false;
+        }
+        const auto &p = result.self;
+        const auto &q = result.other;
+        if (mapping == nullptr || mapping->empty()) {
+            return baseline->contains(p.declaredClassName, p.name, p.type, q.declaredClassName);
+        }
+        return baseline->contains(
+                mapping->deobfuscateType(p.declaredClassName).c_str(),
+                mapping->deobfuscateMember(p.declaredClassName, p.name, p.type).c_str(),
+                mapping->deobfuscateType(p.type).c_str(),
+                mapping->deobfuscateType(q.declaredClassName).c_str());
+    }
+
+    NO_COPY(ApkFile)
+
+    /**
+     * 支持普通 apk、aab (dex 在 base/dex、feature/dex 下)、以及 .apks 这种套了一层 zip 的 apk 集合，
+     * 多次调用会把所有 dex 合并到一起 (比如 split apk)，因为 feature 模块里的类会继承 base 里的类
+     */
+    int open(const char *path, IoBackend backend = IO_AUTO) noexcept
+    {
+        LOGD("open zip file: '%s'\n", path);
+
+        ZipFile zipFile;
+        if (zipFile.open(path, backend) == -1) {
+            PLOGE("failed to open zip file '%s'\n", path);
+            return -1;
+        }
+        return openZip(zipFile, "");
+    }
+
+    /**
+     * 从管道或者标准输入读取 apk/aab/.apks，不需要先落盘：按 local file header 顺序读取，
+     * 每个 dex 流过时就地解压并建立索引。整个继承关系要等所有 dex 都到齐后才能扫描
+     */
+    int openStream(FILE *file, const char *name) noexcept
+    {
+        LOGD("open zip stream: '%s'\n", name);
+
+        ZipStream stream(file);
+        const ZipEntry *e;
+        bool hasDex = false;
+        std::vector<std::pair<std::string, Buffer>> nested;
+        int result;
+
+        while ((result = stream.next(&e)) == 0) {
+            if (isDexEntry(e->name)) {
+                hasDex = true;
+                nested.clear();
+                LOGD("unzip stream entry '%s'\n", e->name);
+                Buffer &buffer = mBufferVec.emplace_back();
+                if (stream.uncompress(&buffer) != 0) {
+                    LOGE("failed to unzip entry '%s' in '%s'\n", e->name, name);
+                    return -1;
+                }
+                if (addDex(buffer, e->name) == -1) {
+                    return -1;
+                }
+            }
+            // 是不是 .apks 这种容器要看有没有 dex，先把内层 apk 留在内存里
+            else if (!hasDex && isApkEntry(e->name)) {
+                auto &it = nested.emplace_back(e->name, Buffer());
+                if (stream.uncompress(&it.second) != 0) {
+                    LOGE("failed to unzip entry '%s' in '%s'\n", e->name, name);
+                    return -1;
+                }
+            }
+        }
+        if (result < 0) {
+            LOGE("failed to read zip stream '%s'\n", name);
+            return -1;
+        }
+
+        bool hasSplits = std::any_of(nested.begin(), nested.end(), [](const auto &it) {
+            return startsWith(it.first.c_str(), "splits/");
+        });
+        for (auto &[entryName, buffer] : nested) {
+            if (hasSplits && !startsWith(entryName.c_str(), "splits/")) {
+                continue;
+            }
+            ZipFile inner;
+            if (inner.open(buffer.data(), buffer.size()) == -1 || openZip(inner, entryName + "!") == -1) {
+                LOGE("failed to open nested zip '%s'\n", entryName.c_str());
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * 有过滤器时只从被接受的类开始解析，其它类只有在被它们继承时才会生成字段表，
+     * 不相关的三方库整棵子树都不会被解析
+     */
+    std::vector<ScanResult> scanAll(const ScanOptions &options = {}) noexcept
+    {
+        std::vector<ScanResult> vec;
+
+        // 字段表只在一次扫描内有效，重复扫描 (比如守护进程模式) 时需要重新生成；每次的 mapping 也可能不同
+        mResolvedClassMap.clear();
+        mDeobfuscatedNameMap.clear();
+
+        std::vector<const HierarchyRule *> rules = options.rules;
+        if (rules.empty()) {
+            rules.push_back(defaultRule());
+        }
+        u4 needs = needsOf(rules);
+        if ((needs & HierarchyRule::NEED_METHODS) != 0) {
+            for (auto &dex : mDexVec) {
+                dex.prepareProtoStrings();
+            }
+        }
+
+        for (auto &dex : mDexVec) {
+            LOGD("here %s\n", dex.tag.c_str());
+            for (size_t i = 0, n = dex.header.classDefsSize; i < n; ++i) {
+                auto &klass = dex.classes[i];
+                if (!acceptClass(dex, klass, options)) {
+                    continue;
+                }
+                resolveClass(dex, klass, options, rules, needs, &vec);
+                if (options.failFast && !vec.empty()) {
+                    return vec;
+                }
+            }
+        }
+        return vec;
+    }
+
+    /**
+     * 一个类都匹配不上的 include 规则，通常是包名写错了。不检查的话结果为空，baseline 检查会悄悄通过。
+     * 有 mapping 时和扫描一样按还原后的类名匹配
+     */
+    [[nodiscard]]
+    std::vector<std::string> unmatchedIncludes(const ClassFilter &filter,
+                                               const ProguardMapping *mapping = nullptr) const noexcept
+    {
+        const auto &patterns = filter.includePatterns();
+        std::vector<bool> matched(patterns.size(), false);
+        size_t remaining = patterns.size();
+        std::string deobfuscated;
+        for (size_t d = 0; d < mDexVec.size() && remaining > 0; ++d) {
+            const auto &dex = mDexVec[d];
+            for (size_t i = 0, n = dex.header.classDefsSize; i < n && remaining > 0; ++i) {
+                const char *name = dex.getTypeName(dex.classes[i].classIdx);
+                if (mapping != nullptr) {
+                    deobfuscated = mapping->deobfuscateType(name);
+                    name = deobfuscated.c_str();
+                }
+                for (size_t j = 0; j < patterns.size(); ++j) {
+                    if (!matched[j] && startsWith(name, patterns[j].second.c_str())) {
+                        matched[j] = true;
+                        remaining -= 1;
+                    }
+                }
+            }
+        }
+        std::vector<std::string> unmatched;
+        for (size_t j = 0; j < patterns.size(); ++j) {
+            if (!matched[j]) {
+                unmatched.push_back(patterns[j].first);
+            }
+        }
+        return unmatched;
+    }
+
+    /**
+     * 两个 apk 里的 dex 是否完全一致 (按 sha1 签名逐个比较)
+     */
+    [[nodiscard]]
+    bool sameDexAs(const ApkFile &other) const noexcept
+    {
+        if (mDexVec.size() != other.mDexVec.size()) {
+            return false;
+        }
+        for (size_t i = 0, n = mDexVec.size(); i < n; ++i) {
+            if (memcmp(mDexVec[i].header.signature, other.mDexVec[i].header.signature,
+                       DexHeader::kSHA1DigestLen) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static inline void appendMember(std::string *line, const ResolvedMember &member,
+                                const ProguardMapping *mapping) noexcept
+{
+    // 字段：Lcls;->name:I，方法：Lcls;->name(I)V
+    const char *sep = member.isMethod() ? "" : ":";
+    if (mapping == nullptr || mapping->empty()) {
+        line->append(member.declaredClassName).append("->").append(member.name).append(sep).append(member.type);
+        return;
+    }
+    line->append(mapping->deobfuscateType(member.declaredClassName)).append("->")
+        .append(mapping->deobfuscateMember(member.declaredClassName, member.name, member.type)).append(sep)
+        .append(mapping->deobfuscateType(member.type));
+}
+
+/**
+ * 默认规则的输出格式保持不变，其它规则在行尾加上 " [规则名]"
+ */
+static inline std::string formatScanResult(const ScanResult &result,
+                                           const ProguardMapping *mapping = nullptr) noexcept
+{
+    std::string line;
+    appendMember(&line, result.self, mapping);
+    line.append("' <==> '");
+    appendMember(&line, result.other, mapping);
+    if (result.rule != defaultRule()->name()) {
+        line.append(" [").append(result.rule).append("]");
+    }
+    return line;
+}
+
+#endif // APK_H
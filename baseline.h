@@ -0,0 +1,111 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include "types.h"
+
+/**
+ * 已知问题列表，用于 CI 只对新增的问题报错。
+ * 文件格式就是本工具的输出，每行一个结果，空行和 '#' 开头的行会被忽略：
+ *   Lcom/foo/Child;->name:I' <==> 'Lcom/foo/Base;->name:I
+ *   Lcom/foo/Child;->run(I)V' <==> 'Lcom/foo/Base;->run(I)V [static-method-hiding]
+ *
+ * 内存里只保存 (类, 字段名, 类型, 父类) 的 64 位哈希，查询时不需要拼接字符串
+ */
+class Baseline
+{
+private:
+    std::unordered_set<u8> mFingerprints;
+
+    static u8 hash(u8 h, const char *begin, const char *end) noexcept
+    {
+        // FNV-1a，每段后面加一个分隔符，避免 ("ab", "c") 和 ("a", "bc") 撞在一起
+        for (auto p = begin; p < end; ++p) {
+            h = (h ^ (u1) *p) * 0x100000001b3ULL;
+        }
+        return (h ^ 0xff) * 0x100000001b3ULL;
+    }
+
+    static u8 hash(u8 h, const char *s) noexcept { return hash(h, s, s + strlen(s)); }
+
+    static constexpr u8 kSeed = 0xcbf29ce484222325ULL;
+
+    /**
+     * 解析 "Lcls;->name:type" 形式的字段描述或者 "Lcls;->name(I)V" 形式的方法描述
+     */
+    static bool split(const char *begin, const char *end,
+                      const char **name, const char **nameEnd, const char **type) noexcept
+    {
+        auto arrow = std::search(begin, end, "->", "->" + 2);
+        if (arrow == end) return false;
+        *name = arrow + 2;
+        *nameEnd = std::find_if(*name, end, [](char ch) { return ch == ':' || ch == '('; });
+        if (*nameEnd == end) return false;
+        *type = **nameEnd == ':' ? *nameEnd + 1 : *nameEnd;
+        return true;
+    }
+
+public:
+    /**
+     * 读取失败返回 -1，无法识别的行会被跳过
+     */
+    int load(const char *path) noexcept
+    {
+        FILE *fp = fopen(path, "r");
+        if (fp == nullptr) {
+            return -1;
+        }
+        static constexpr char SEP[] = "' <==> '";
+
+        std::string line;
+        char buff[4096];
+        while (fgets(buff, sizeof(buff), fp) != nullptr) {
+            line.append(buff);
+            if (line.back() != '\n' && !feof(fp)) {
+                continue;
+            }
+            while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+                line.pop_back();
+            }
+
+            auto begin = line.c_str(), end = begin + line.size();
+            auto sep = std::search(begin, end, SEP, SEP + sizeof(SEP) - 1);
+            const char *name, *nameEnd, *type, *superName, *superNameEnd, *superType;
+            if (line.empty() || line[0] == '#' || sep == end
+                || !split(begin, sep, &name, &nameEnd, &type)
+                || !split(sep + sizeof(SEP) - 1, end, &superName, &superNameEnd, &superType)) {
+                line.clear();
+                continue;
+            }
+            u8 h = hash(kSeed, begin, name - 2);
+            h = hash(h, name, nameEnd);
+            h = hash(h, type, sep);
+            h = hash(h, sep + sizeof(SEP) - 1, superName - 2);
+            mFingerprints.insert(h);
+            line.clear();
+        }
+        fclose(fp);
+        return 0;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept { return mFingerprints.empty(); }
+
+    [[nodiscard]]
+    size_t size() const noexcept { return mFingerprints.size(); }
+
+    [[nodiscard]]
+    bool contains(const char *className, const char *name, const char *type,
+                  const char *superClassName) const noexcept
+    {
+        u8 h = hash(hash(hash(hash(kSeed, className), name), type), superClassName);
+        return mFingerprints.find(h) != mFingerprints.end();
+    }
+};
+
+#endif // BASELINE_H
@@ -0,0 +1,528 @@
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "apk.h"
+#include "daemon.h"
+#include "log.h"
+#include "scan.h"
+
+static size_t writeFully(int fd, const void *src, size_t size) noexcept
+{
+    size_t consumed = 0;
+    while (consumed < size) {
+        auto bytes = send(fd, (const char *) src + consumed, size - consumed, MSG_NOSIGNAL);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        consumed += bytes;
+    }
+    return consumed;
+}
+
+class LineReader
+{
+private:
+    static constexpr size_t MAX_LINE = 64 * 1024;
+
+    int mFd;
+    char mBuff[4096];
+    size_t mBegin = 0;
+    size_t mEnd = 0;
+
+public:
+    explicit LineReader(int fd) noexcept : mFd(fd) {}
+    NO_COPY(LineReader)
+
+    bool next(std::string *line) noexcept
+    {
+        line->clear();
+        while (line->size() < MAX_LINE) {
+            if (mBegin == mEnd) {
+                auto bytes = read(mFd, mBuff, sizeof(mBuff));
+                if (bytes < 0 && errno == EINTR) continue;
+                if (bytes <= 0) return false;
+                mBegin = 0;
+                mEnd = bytes;
+            }
+            auto newline = (char *) memchr(mBuff + mBegin, '\n', mEnd - mBegin);
+            auto stop = newline == nullptr ? mBuff + mEnd : newline;
+            line->append(mBuff + mBegin, stop);
+            mBegin = stop - mBuff;
+            if (newline != nullptr) {
+                mBegin += 1;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static std::vector<std::string> splitArgs(const std::string &line) noexcept
+{
+    std::vector<std::string> args;
+    size_t start = 0;
+    while (start <= line.size()) {
+        auto end = line.find('\t', start);
+        if (end == std::string::npos) end = line.size();
+        if (end > start) args.emplace_back(line, start, end - start);
+        start = end + 1;
+    }
+    return args;
+}
+
+/**
+ * 一次打开 + 扫描的结果。扫描结果里的字符串都指向 apk 里的 dex 缓冲区，
+ * 所以两者的生命周期绑在一起，用 shared_ptr 保证旧快照在被替换后，正在输出它的请求仍然可用
+ */
+struct ApkSnapshot
+{
+    ApkFile apk;
+    std::vector<ScanResult> results;   // 不带任何选项的扫描结果
+
+    // 带选项的请求需要重新扫描，ApkFile 扫描时会修改内部状态，同一个 apk 的扫描要串行
+    std::mutex scanLock;
+};
+
+/**
+ * 按路径索引的缓存条目，最多保留 capacity 个，超出时淘汰最久没用过的。
+ * 被淘汰的条目只是从表里移除，正在使用它的请求手里还有 shared_ptr
+ */
+template <typename Entry>
+class LruIndex
+{
+private:
+    struct Slot
+    {
+        std::shared_ptr<Entry> entry;
+        u8 lastUsed = 0;
+    };
+
+    size_t mCapacity;
+    std::mutex mLock;
+    std::unordered_map<std::string, Slot> mSlots;
+    u8 mClock = 0;
+
+public:
+    explicit LruIndex(size_t capacity) noexcept : mCapacity(capacity) {}
+
+    std::shared_ptr<Entry> entryOf(const std::string &path) noexcept
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto &slot = mSlots[path];
+        if (slot.entry == nullptr) {
+            slot.entry = std::make_shared<Entry>();
+        }
+        slot.lastUsed = ++mClock;
+        auto result = slot.entry;
+
+        if (mSlots.size() > mCapacity) {
+            auto oldest = std::min_element(mSlots.begin(), mSlots.end(), [](const auto &p, const auto &q) {
+                return p.second.lastUsed < q.second.lastUsed;
+            });
+            LOGD("evict '%s'\n", oldest->first.c_str());
+            mSlots.erase(oldest);
+        }
+        return result;
+    }
+
+    void remove(const std::string &path) noexcept
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mSlots.erase(path);
+    }
+};
+
+struct FileStamp
+{
+    struct timespec mtime {};
+    off_t size = 0;
+
+    explicit FileStamp() noexcept = default;
+    explicit FileStamp(const struct stat &st) noexcept : mtime(st.st_mtim), size(st.st_size) {}
+
+    bool operator==(const FileStamp &other) const noexcept
+    {
+        return size == other.size && mtime.tv_sec == other.mtime.tv_sec && mtime.tv_nsec == other.mtime.tv_nsec;
+    }
+};
+
+/**
+ * 按路径列表缓存的 apk 快照，最多保留 16 个；任意一个文件被删除后对应的条目也会被丢弃。
+ * base apk 和 split apk 一起打开时按给出的路径顺序作为一个整体缓存
+ */
+class ApkCache
+{
+private:
+    struct Entry
+    {
+        std::mutex lock;
+        std::shared_ptr<ApkSnapshot> snapshot;
+        std::vector<FileStamp> stamps;
+    };
+
+    LruIndex<Entry> mIndex { 16 };
+
+public:
+    /**
+     * backend 只影响缓存未命中时怎么读取文件，不参与缓存的比较。失败时 failedPath 是出错的那个文件
+     */
+    std::shared_ptr<ApkSnapshot> acquire(const std::vector<std::string> &paths, IoBackend backend,
+                                         std::string *failedPath) noexcept
+    {
+        // 请求是按行的，路径里不会有换行符
+        std::string key;
+        for (const auto &path : paths) {
+            key.append(path).push_back('\n');
+        }
+
+        std::vector<FileStamp> stamps;
+        for (const auto &path : paths) {
+            struct stat st {};
+            if (stat(path.c_str(), &st) != 0) {
+                mIndex.remove(key);
+                *failedPath = path;
+                return nullptr;
+            }
+            stamps.emplace_back(st);
+        }
+        auto entry = mIndex.entryOf(key);
+
+        // 同一组文件同时只允许一个请求去加载，其它请求等它完成后直接用结果
+        std::lock_guard<std::mutex> guard(entry->lock);
+        if (entry->snapshot != nullptr && entry->stamps == stamps) {
+            LOGD("cache hit: '%s'\n", paths[0].c_str());
+            return entry->snapshot;
+        }
+
+        auto snapshot = std::make_shared<ApkSnapshot>();
+        for (const auto &path : paths) {
+            if (snapshot->apk.open(path.c_str(), backend) < 0) {
+                *failedPath = path;
+                return nullptr;
+            }
+        }
+        entry->stamps = std::move(stamps);
+
+        // 文件被 touch 或者重新打包过，但 dex 没有变化，之前的扫描结果仍然有效
+        if (entry->snapshot != nullptr && entry->snapshot->apk.sameDexAs(snapshot->apk)) {
+            LOGD("dex unchanged: '%s'\n", paths[0].c_str());
+            return entry->snapshot;
+        }
+        snapshot->results = snapshot->apk.scanAll();
+        entry->snapshot = snapshot;
+        return entry->snapshot;
+    }
+};
+
+/**
+ * 按路径缓存加载好的 mapping，和 apk 一样以修改时间和大小判断是否失效。
+ * 大的 mapping 建索引也要几百毫秒，不缓存的话每个带 --mapping 的请求都要重新来一遍
+ */
+class MappingCache
+{
+private:
+    struct Entry
+    {
+        std::mutex lock;
+        std::shared_ptr<const ProguardMapping> mapping;
+        FileStamp stamp;
+    };
+
+    LruIndex<Entry> mIndex { 4 };
+
+public:
+    std::shared_ptr<const ProguardMapping> acquire(const std::string &path) noexcept
+    {
+        struct stat st {};
+        if (stat(path.c_str(), &st) != 0) {
+            mIndex.remove(path);
+            return nullptr;
+        }
+        auto entry = mIndex.entryOf(path);
+
+        std::lock_guard<std::mutex> guard(entry->lock);
+        if (entry->mapping != nullptr && entry->stamp == FileStamp(st)) {
+            LOGD("mapping cache hit: '%s'\n", path.c_str());
+            return entry->mapping;
+        }
+        // 构建会原地覆盖 mapping.txt，常驻的 mmap 会读到改写后的内容甚至 SIGBUS，所以读进内存
+        auto mapping = loadMapping(path, true);
+        if (mapping == nullptr) {
+            return nullptr;
+        }
+        entry->mapping = mapping;
+        entry->stamp = FileStamp(st);
+        return mapping;
+    }
+};
+
+class Daemon
+{
+private:
+    // 连上之后迟迟不发请求、或者发了请求却不读结果的客户端不能一直占着工作线程
+    static constexpr time_t IO_TIMEOUT_SECONDS = 30;
+
+    ApkCache mCache;
+    MappingCache mMappings;
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::queue<int> mClients;
+
+    void reply(int fd, const std::string &line) noexcept
+    {
+        writeFully(fd, line.data(), line.size());
+    }
+
+    void handleClient(int fd) noexcept
+    {
+        std::string line;
+        LineReader reader(fd);
+        if (!reader.next(&line)) {
+            return;
+        }
+        ScanArgs args;
+        std::string error;
+        auto loader = [this](const std::string &path) { return mMappings.acquire(path); };
+        if (parseScanArgs(splitArgs(line), &args, &error, loader) < 0) {
+            reply(fd, "ERR " + error + "\nEND 1\n");
+            return;
+        }
+        if (args.paths.empty()) {
+            reply(fd, "ERR usage: [options...] [apkPath...]\nEND 1\n");
+            return;
+        }
+        std::string failedPath;
+        auto snapshot = mCache.acquire(args.paths, args.io, &failedPath);
+        if (snapshot == nullptr) {
+            reply(fd, "ERR failed to open '" + failedPath + "'\nEND 1\n");
+            return;
+        }
+        auto options = args.toScanOptions();
+        auto unmatched = snapshot->apk.unmatchedIncludes(args.filter, options.mapping);
+        if (!unmatched.empty()) {
+            std::string buff;
+            for (const auto &pattern : unmatched) {
+                buff.append("ERR include pattern '" + pattern + "' matches no class\n");
+            }
+            reply(fd, buff + "END 1\n");
+            return;
+        }
+
+        // 过滤器只决定报告哪些类，不影响类怎么解析，所以只用默认规则时直接在缓存的完整结果上
+        // 应用过滤器、baseline 和 fail-fast，只有启用了其它规则才需要带着选项重新扫描
+        std::vector<ScanResult> results;
+        if (args.rules.empty() || (args.rules.size() == 1 && args.rules[0] == defaultRule())) {
+            // 和 scanAll 一样按还原后的类名过滤；类名指向 dex 里的字符串，同一个类的结果共用一个指针
+            std::unordered_map<const char *, bool> accepted;
+            auto accept = [&](const char *className) {
+                auto found = accepted.find(className);
+                if (found == accepted.end()) {
+                    auto name = options.mapping == nullptr ? std::string(className)
+                                                           : options.mapping->deobfuscateType(className);
+                    found = accepted.emplace(className, options.filter->accept(name.c_str())).first;
+                }
+                return found->second;
+            };
+            for (const auto &it : snapshot->results) {
+                if (options.filter != nullptr && !accept(it.self.declaredClassName)) {
+                    continue;
+                }
+                if (ApkFile::isSuppressed(it, options.baseline, options.mapping)) {
+                    continue;
+                }
+                results.push_back(it);
+                if (args.failFast) break;
+            }
+        }
+        else {
+            std::lock_guard<std::mutex> guard(snapshot->scanLock);
+            results = snapshot->apk.scanAll(options);
+        }
+
+        // 结果可能非常多，攒够一批就发出去，不必等全部格式化完
+        std::string buff;
+        for (const auto &it : results) {
+            buff.append(formatScanResult(it, options.mapping)).push_back('\n');
+            if (buff.size() >= 64 * 1024) {
+                reply(fd, buff);
+                buff.clear();
+            }
+        }
+        buff.append("END " + std::to_string(args.exitCodeFor(results.size())) + "\n");
+        reply(fd, buff);
+    }
+
+    void workerLoop() noexcept
+    {
+        for (;;) {
+            int fd;
+            {
+                std::unique_lock<std::mutex> guard(mLock);
+                mCond.wait(guard, [this] { return !mClients.empty(); });
+                fd = mClients.front();
+                mClients.pop();
+            }
+            handleClient(fd);
+            ::close(fd);
+        }
+    }
+
+    /**
+     * 上一个守护进程异常退出时会留下 socket 文件，只有确认没有进程在监听时才删除它，
+     * 否则第二个守护进程会悄悄抢走正在运行的那个的 socket
+     */
+    static int removeStaleSocket(const struct sockaddr_un &addr) noexcept
+    {
+        struct stat st {};
+        if (lstat(addr.sun_path, &st) != 0) {
+            return 0;
+        }
+        if (!S_ISSOCK(st.st_mode)) {
+            LOGE("'%s' exists and is not a socket\n", addr.sun_path);
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe < 0) {
+            PLOGE("failed to create socket: ");
+            return -1;
+        }
+        int result = connect(probe, (const struct sockaddr *) &addr, sizeof(addr));
+        int error = errno;
+        ::close(probe);
+        if (result == 0) {
+            LOGE("another daemon is already listening on '%s'\n", addr.sun_path);
+            return -1;
+        }
+        if (error != ECONNREFUSED) {
+            errno = error;
+            PLOGE("failed to probe '%s': ", addr.sun_path);
+            return -1;
+        }
+        unlink(addr.sun_path);
+        return 0;
+    }
+
+public:
+    int serve(const char *socketPath, size_t workers) noexcept
+    {
+        struct sockaddr_un addr {};
+        if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+            LOGE("socket path '%s' is too long\n", socketPath);
+            return -1;
+        }
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, socketPath);
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0) {
+            PLOGE("failed to create socket: ");
+            return -1;
+        }
+        if (removeStaleSocket(addr) != 0) {
+            ::close(server);
+            return -1;
+        }
+        if (bind(server, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(server, 128) != 0) {
+            PLOGE("failed to listen on '%s': ", socketPath);
+            ::close(server);
+            return -1;
+        }
+        LOGD("listening on '%s' with %zu workers\n", socketPath, workers);
+
+        for (size_t i = 0; i < workers; ++i) {
+            std::thread(&Daemon::workerLoop, this).detach();
+        }
+        for (;;) {
+            int client = accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                PLOGE("failed to accept: ");
+                break;
+            }
+            struct timeval timeout { IO_TIMEOUT_SECONDS, 0 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            {
+                std::lock_guard<std::mutex> guard(mLock);
+                mClients.push(client);
+            }
+            mCond.notify_one();
+        }
+        ::close(server);
+        return -1;
+    }
+};
+
+int runDaemon(const char *socketPath, size_t workers) noexcept
+{
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // 工作线程是 detach 的，守护进程对象要一直活到进程退出
+    static Daemon daemon;
+    return daemon.serve(socketPath, workers);
+}
+
+int runClient(const char *socketPath, int argc, const char *argv[]) noexcept
+{
+    struct sockaddr_un addr {};
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        LOGE("socket path '%s' is too long\n", socketPath);
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        PLOGE("failed to connect to '%s': ", socketPath);
+        if (fd >= 0) ::close(fd);
+        return 1;
+    }
+    std::unique_ptr<int, void (*)(const int *)> fdGuard(&fd, [](const int *p) { ::close(*p); });
+
+    // 守护进程的工作目录和客户端不同，文件路径要先转成绝对路径
+    std::vector<std::string> args(argv, argv + argc);
+    absolutizeScanArgs(&args);
+
+    std::string request;
+    for (const auto &arg : args) {
+        if (!request.empty()) request.push_back('\t');
+        request.append(arg);
+    }
+    request.push_back('\n');
+    if (writeFully(fd, request.data(), request.size()) != request.size()) {
+        PLOGE("failed to send request: ");
+        return 1;
+    }
+
+    std::string line;
+    LineReader reader(fd);
+    while (reader.next(&line)) {
+        if (line.compare(0, 4, "END ") == 0) {
+            return atoi(line.c_str() + 4);
+        }
+        if (line.compare(0, 4, "ERR ") == 0) {
+            LOGE("%s\n", line.c_str() + 4);
+            continue;
+        }
+        LOGI("%s\n", line.c_str());
+    }
+    LOGE("connection closed unexpectedly\n");
+    return 1;
+}
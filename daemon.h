@@ -0,0 +1,23 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <cstddef>
+
+/**
+ * 守护进程模式：监听一个本地 unix socket，在内存里常驻已经解析好的 apk (dex 索引、类名索引)，
+ * 避免 IDE 插件、提交前检查等频繁调用时每次都重新解压和建索引。
+ *
+ * 协议是按行的文本：
+ *   请求：一行，参数之间用 '\t' 分隔，和命令行参数一致，比如 "/path/to/app.apk\n"，
+ *        多个路径 (base apk 加 split apk) 会合并成一个类层级来扫描
+ *   响应：每个扫描结果一行，格式和命令行输出一致，出错时输出 "ERR <原因>" 行，
+ *        最后以 "END <退出码>" 行结束
+ */
+int runDaemon(const char *socketPath, size_t workers) noexcept;
+
+/**
+ * 客户端：把参数发给守护进程，并把结果原样打印出来，返回值即守护进程给出的退出码
+ */
+int runClient(const char *socketPath, int argc, const char *argv[]) noexcept;
+
+#endif // DAEMON_H
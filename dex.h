@@ -83,4 +83,18 @@ struct DexClassDef {
 };
 
 
+struct Modifier
+{
+    static constexpr u4 ACC_PUBLIC      = 0x0001;
+    static constexpr u4 ACC_PRIVATE     = 0x0002;
+    static constexpr u4 ACC_PROTECTED   = 0x0004;
+    static constexpr u4 ACC_STATIC      = 0x0008;
+    static constexpr u4 ACC_FINAL       = 0x0010;
+    static constexpr u4 ACC_VOLATILE    = 0x0040;
+    static constexpr u4 ACC_TRANSIENT   = 0x0080;
+    static constexpr u4 ACC_SYNTHETIC   = 0x1000;
+    static constexpr u4 ACC_INTERFACE   = 0x0200;
+    static constexpr u4 ACC_CONSTRUCTOR = 0x10000;
+};
+
 #endif // DEX_H
\ No newline at end of file
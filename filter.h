@@ -0,0 +1,120 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * 前缀树：判断一个字符串是否以任意一个已插入的前缀开头，查询耗时只和字符串本身的长度有关
+ */
+class PrefixTrie
+{
+private:
+    struct Node
+    {
+        std::vector<std::pair<char, u4>> next;  // 分支很少，线性查找比 map 更快
+        bool terminal = false;
+    };
+    std::vector<Node> mNodes { Node() };
+
+    [[nodiscard]]
+    u4 childOf(u4 node, char ch) const noexcept
+    {
+        for (const auto &it : mNodes[node].next) {
+            if (it.first == ch) return it.second;
+        }
+        return 0;
+    }
+
+public:
+    void insert(const std::string &prefix) noexcept
+    {
+        u4 node = 0;
+        for (char ch : prefix) {
+            u4 child = childOf(node, ch);
+            if (child == 0) {
+                child = (u4) mNodes.size();
+                mNodes[node].next.emplace_back(ch, child);
+                mNodes.emplace_back();
+            }
+            node = child;
+        }
+        mNodes[node].terminal = true;
+    }
+
+    [[nodiscard]]
+    bool empty() const noexcept { return mNodes.size() == 1 && !mNodes[0].terminal; }
+
+    [[nodiscard]]
+    bool matches(const char *s) const noexcept
+    {
+        u4 node = 0;
+        for (;;) {
+            if (mNodes[node].terminal) return true;
+            if (*s == '\0') return false;
+            if ((node = childOf(node, *s++)) == 0) return false;
+        }
+    }
+};
+
+/**
+ * 按包名过滤要报告的类。include 为空时表示包含所有类，exclude 优先于 include
+ */
+class ClassFilter
+{
+private:
+    PrefixTrie mInclude;
+    PrefixTrie mExclude;
+    std::vector<std::pair<std::string, std::string>> mIncludePatterns;   // (原始写法, 描述符前缀)
+
+    /**
+     * 末尾的通配符会被去掉，"com/ourco/" 加上 "**" 或者 "com.ourco." 加上 "*" 都转成类描述符前缀 "Lcom/ourco/"。
+     * 本身就是描述符 (以 'L' 开头、以 ';' 结尾或者用 '/' 分隔，比如 "Lcom/ourco/"、"Lcom/ourco/Foo;") 时原样使用
+     */
+    static std::string toDescriptorPrefix(std::string pattern) noexcept
+    {
+        while (!pattern.empty() && pattern.back() == '*') {
+            pattern.pop_back();
+        }
+        if (pattern.size() > 1 && pattern[0] == 'L' && pattern.find('.') == std::string::npos
+            && (pattern.back() == ';' || pattern.find('/') != std::string::npos)) {
+            return pattern;
+        }
+        std::replace(pattern.begin(), pattern.end(), '.', '/');
+        return "L" + pattern;
+    }
+
+public:
+    void include(const std::string &pattern) noexcept
+    {
+        auto prefix = toDescriptorPrefix(pattern);
+        mInclude.insert(prefix);
+        mIncludePatterns.emplace_back(pattern, prefix);
+    }
+
+    void exclude(const std::string &pattern) noexcept { mExclude.insert(toDescriptorPrefix(pattern)); }
+
+    [[nodiscard]]
+    bool empty() const noexcept { return mInclude.empty() && mExclude.empty(); }
+
+    [[nodiscard]]
+    bool accept(const char *descriptor) const noexcept
+    {
+        if (mExclude.matches(descriptor)) return false;
+        return mInclude.empty() || mInclude.matches(descriptor);
+    }
+
+    /**
+     * 每个 include 规则的原始写法和对应的描述符前缀，用于检查有没有写错了、一个类都匹配不上的规则
+     */
+    [[nodiscard]]
+    const std::vector<std::pair<std::string, std::string>> &includePatterns() const noexcept
+    {
+        return mIncludePatterns;
+    }
+};
+
+#endif // FILTER_H
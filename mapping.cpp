@@ -0,0 +1,408 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "mapping.h"
+
+static constexpr std::string_view ARROW = " -> ";
+
+static inline std::string_view trim(std::string_view s) noexcept
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t' || s.back() == '\r')) s.remove_suffix(1);
+    return s;
+}
+
+static inline bool isMemberLine(const char *p) noexcept
+{
+    return *p == ' ' || *p == '\t';
+}
+
+/**
+ * 从 p 开始找下一个类的起始行，作为并行解析时每一段的边界
+ */
+static const char *nextClassHeader(const char *begin, const char *p, const char *end) noexcept
+{
+    if (p > begin && p[-1] != '\n') {
+        auto eol = (const char *) memchr(p, '\n', end - p);
+        p = eol == nullptr ? end : eol + 1;
+    }
+    while (p < end && (isMemberLine(p) || *p == '#' || *p == '\r' || *p == '\n')) {
+        auto eol = (const char *) memchr(p, '\n', end - p);
+        p = eol == nullptr ? end : eol + 1;
+    }
+    return p;
+}
+
+void ProguardMapping::indexRange(const char *begin, const char *end, std::vector<ClassRecord> *out) noexcept
+{
+    ClassRecord *current = nullptr;
+
+    for (const char *p = begin; p < end; ) {
+        auto eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+        auto lineBegin = p;
+        p = eol + 1;
+
+        // 成员行留到第一次查询这个类时再解析
+        if (isMemberLine(lineBegin)) {
+            continue;
+        }
+        auto line = trim(std::string_view(lineBegin, eol - lineBegin));
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        auto arrow = line.find(ARROW);
+        if (arrow == std::string_view::npos) {
+            continue;
+        }
+
+        // 类：com.foo.Bar -> a.b:
+        auto obfuscated = trim(line.substr(arrow + ARROW.size()));
+        if (!obfuscated.empty() && obfuscated.back() == ':') {
+            obfuscated.remove_suffix(1);
+        }
+        if (current != nullptr) {
+            current->members = std::string_view(current->members.data(), lineBegin - current->members.data());
+        }
+        current = &out->emplace_back();
+        current->name = trim(line.substr(0, arrow));
+        current->obfuscatedName = obfuscated;
+        current->members = std::string_view(std::min(p, end), 0);
+    }
+    if (current != nullptr) {
+        current->members = std::string_view(current->members.data(), end - current->members.data());
+    }
+}
+
+void ProguardMapping::parseMembers(std::string_view text, Members *out) noexcept
+{
+    const char *end = text.data() + text.size();
+    for (const char *p = text.data(); p < end; ) {
+        auto eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+        auto line = trim(std::string_view(p, eol - p));
+        p = eol + 1;
+
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        auto arrow = line.find(ARROW);
+        if (arrow == std::string_view::npos) {
+            continue;
+        }
+
+        // 方法：1:3:void doIt(int,java.lang.String):10:12 -> a，行号部分可能没有
+        auto left = line.substr(0, arrow);
+        auto open = left.find('(');
+        if (open != std::string_view::npos) {
+            auto close = left.find(')', open);
+            auto head = left.substr(0, open);
+            auto space = head.rfind(' ');
+            if (close == std::string_view::npos || space == std::string_view::npos) {
+                continue;
+            }
+            auto returnType = head.substr(0, space);
+            returnType.remove_prefix(std::min(returnType.size(), returnType.find_last_of(':') + 1));
+            out->methods.push_back({
+                .returnType = returnType,
+                .name = head.substr(space + 1),
+                .parameters = left.substr(open + 1, close - open - 1),
+                .obfuscatedName = trim(line.substr(arrow + ARROW.size())),
+            });
+            continue;
+        }
+
+        // 字段：java.lang.String name -> a
+        auto space = left.rfind(' ');
+        if (space == std::string_view::npos) {
+            continue;
+        }
+        out->fields.push_back({
+            .type = trim(left.substr(0, space)),
+            .name = left.substr(space + 1),
+            .obfuscatedName = trim(line.substr(arrow + ARROW.size())),
+        });
+    }
+}
+
+const ProguardMapping::Members &ProguardMapping::membersOf(const ClassRecord *klass) const noexcept
+{
+    auto index = (u4) (klass - mClasses.data());
+    std::lock_guard<std::mutex> guard(mMembersLock);
+    auto it = mMembers.find(index);
+    if (it == mMembers.end()) {
+        it = mMembers.emplace(index, Members()).first;
+        parseMembers(klass->members, &it->second);
+    }
+    // unordered_map 插入新元素时已有元素的引用不会失效
+    return it->second;
+}
+
+static int readFile(int fd, char *dst, size_t size) noexcept
+{
+    size_t consumed = 0;
+    while (consumed < size) {
+        auto bytes = read(fd, dst + consumed, size - consumed);
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        consumed += bytes;
+    }
+    return consumed == size ? 0 : -1;
+}
+
+int ProguardMapping::load(const char *path, bool copy, size_t threads) noexcept
+{
+    static constexpr size_t kMinChunk = 4 * 1024 * 1024;
+
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        ::close(fd);
+        return 0;
+    }
+    if (copy) {
+        auto data = new (std::nothrow) char[st.st_size];
+        if (data == nullptr || readFile(fd, data, st.st_size) != 0) {
+            delete[] data;
+            ::close(fd);
+            return -1;
+        }
+        mData = data;
+        mOwned = true;
+    }
+    else {
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            return -1;
+        }
+        mData = (const char *) addr;
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+    mLength = st.st_size;
+
+    // 按类的起始行切分，每段交给一个线程建索引
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::max((size_t) 1, std::min(threads, mLength / kMinChunk));
+
+    const char *end = mData + mLength;
+    std::vector<const char *> bounds { mData };
+    for (size_t i = 1; i < threads; ++i) {
+        auto p = nextClassHeader(mData, mData + mLength / threads * i, end);
+        if (p > bounds.back() && p < end) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+
+    std::vector<std::vector<ClassRecord>> chunks(bounds.size() - 1);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        workers.emplace_back(indexRange, bounds[i], bounds[i + 1], &chunks[i]);
+    }
+    indexRange(bounds[0], bounds[1], &chunks[0]);
+    for (auto &it : workers) {
+        it.join();
+    }
+
+    size_t total = 0;
+    for (const auto &chunk : chunks) total += chunk.size();
+    mClasses.reserve(total);
+    mClassIndex.reserve(total);
+    for (auto &chunk : chunks) {
+        for (auto &it : chunk) {
+            mClassIndex.emplace(it.obfuscatedName, (u4) mClasses.size());
+            mClasses.push_back(it);
+        }
+    }
+    LOGD("indexed %zu classes from mapping '%s' with %zu threads\n", mClasses.size(), path, chunks.size());
+    return 0;
+}
+
+void ProguardMapping::close() noexcept
+{
+    mMembers.clear();
+    mClassIndex.clear();
+    mClasses.clear();
+    if (mData != nullptr) {
+        if (mOwned) {
+            delete[] mData;
+        }
+        else {
+            munmap((void *) mData, mLength);
+        }
+        mData = nullptr;
+    }
+    mOwned = false;
+    mLength = 0;
+}
+
+const ProguardMapping::ClassRecord *ProguardMapping::findClass(const char *descriptor) const noexcept
+{
+    size_t len = strlen(descriptor);
+    if (len < 3 || descriptor[0] != 'L' || descriptor[len - 1] != ';') {
+        return nullptr;
+    }
+    std::string javaName(descriptor + 1, len - 2);
+    std::replace(javaName.begin(), javaName.end(), '/', '.');
+
+    auto it = mClassIndex.find(javaName);
+    return it == mClassIndex.end() ? nullptr : &mClasses[it->second];
+}
+
+std::string ProguardMapping::deobfuscateType(const char *descriptor) const noexcept
+{
+    std::string result;
+    std::string klass;
+    for (auto p = descriptor; *p != '\0'; ) {
+        if (*p != 'L') {
+            result.push_back(*p++);
+            continue;
+        }
+        auto end = strchr(p, ';');
+        if (end == nullptr) {
+            result.append(p);
+            break;
+        }
+        klass.assign(p, end + 1);
+        auto record = findClass(klass.c_str());
+        if (record == nullptr) {
+            result.append(klass);
+        }
+        else {
+            auto begin = result.size();
+            result.append("L").append(record->name).append(";");
+            std::replace(result.begin() + (long) begin, result.end(), '.', '/');
+        }
+        p = end + 1;
+    }
+    return result;
+}
+
+/**
+ * 把类型描述符转成 mapping.txt 里的 java 写法，比如 "[Ljava/lang/String;" -> "java.lang.String[]"
+ */
+static std::string toJavaType(const std::string &descriptor) noexcept
+{
+    size_t dims = 0;
+    while (dims < descriptor.size() && descriptor[dims] == '[') dims += 1;
+
+    std::string result;
+    switch (dims < descriptor.size() ? descriptor[dims] : '\0') {
+        case 'Z': result = "boolean"; break;
+        case 'B': result = "byte"; break;
+        case 'C': result = "char"; break;
+        case 'S': result = "short"; break;
+        case 'I': result = "int"; break;
+        case 'J': result = "long"; break;
+        case 'F': result = "float"; break;
+        case 'D': result = "double"; break;
+        case 'L':
+            result = descriptor.substr(dims + 1, descriptor.size() - dims - 2);
+            std::replace(result.begin(), result.end(), '/', '.');
+            break;
+        default: return descriptor;
+    }
+    for (size_t i = 0; i < dims; ++i) result.append("[]");
+    return result;
+}
+
+std::string ProguardMapping::deobfuscateField(const char *classDescriptor, const char *name,
+                                              const char *type) const noexcept
+{
+    auto klass = findClass(classDescriptor);
+    if (klass == nullptr) {
+        return name;
+    }
+    const FieldRecord *found = nullptr;
+    std::string javaType;
+    for (const auto &field : membersOf(klass).fields) {
+        if (field.obfuscatedName != name) {
+            continue;
+        }
+        if (found == nullptr) {
+            found = &field;
+            continue;
+        }
+        // 同一个混淆名对应了多个字段，用类型区分
+        if (javaType.empty()) {
+            javaType = toJavaType(deobfuscateType(type));
+        }
+        if (field.type == javaType) {
+            found = &field;
+        }
+    }
+    return found == nullptr ? name : std::string(found->name);
+}
+
+/**
+ * 把方法原型描述符转成 mapping.txt 里的写法，比如 "(ILjava/lang/String;)V" -> "int,java.lang.String" 和 "void"
+ */
+static void toJavaProto(const std::string &proto, std::string *parameters, std::string *returnType) noexcept
+{
+    auto close = proto.find(')');
+    if (proto.empty() || proto[0] != '(' || close == std::string::npos) {
+        return;
+    }
+    for (size_t p = 1; p < close; ) {
+        size_t end = p;
+        while (end < close && proto[end] == '[') end += 1;
+        if (proto[end] == 'L') {
+            end = proto.find(';', end);
+            if (end == std::string::npos || end > close) return;
+        }
+        end += 1;
+        if (!parameters->empty()) parameters->push_back(',');
+        parameters->append(toJavaType(proto.substr(p, end - p)));
+        p = end;
+    }
+    auto ret = proto.substr(close + 1);
+    *returnType = ret == "V" ? "void" : toJavaType(ret);
+}
+
+std::string ProguardMapping::deobfuscateMethod(const char *classDescriptor, const char *name,
+                                               const char *proto) const noexcept
+{
+    auto klass = findClass(classDescriptor);
+    if (klass == nullptr) {
+        return name;
+    }
+    const MethodRecord *found = nullptr;
+    bool resolved = false;
+    std::string parameters, returnType;
+    for (const auto &method : membersOf(klass).methods) {
+        if (method.obfuscatedName != name) {
+            continue;
+        }
+        // 同一个方法有多个行号区间时会出现多行，按原型匹配第一条
+        if (!resolved) {
+            toJavaProto(deobfuscateType(proto), &parameters, &returnType);
+            resolved = true;
+        }
+        if (method.parameters == parameters && method.returnType == returnType) {
+            found = &method;
+            break;
+        }
+        if (found == nullptr) {
+            found = &method;
+        }
+    }
+    return found == nullptr ? name : std::string(found->name);
+}
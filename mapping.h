@@ -0,0 +1,118 @@
+#ifndef MAPPING_H
+#define MAPPING_H
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * ProGuard/R8 的 mapping.txt，用于把扫描结果里混淆过的类名、字段名还原回来。
+ *
+ * 加载时只按类的起始行切成若干段并行建立类名索引，记下每个类的成员行所在的范围；
+ * 成员行要等某个结果第一次查到这个类时才解析，几百 MB 的 mapping 也只需要解析用到的那几个类。
+ * 索引里只保存指向文件内容的 string_view，不拷贝字符串
+ */
+class ProguardMapping
+{
+private:
+    struct FieldRecord
+    {
+        std::string_view type;          // 原始的 java 类型，比如 java.lang.String
+        std::string_view name;
+        std::string_view obfuscatedName;
+    };
+
+    struct MethodRecord
+    {
+        std::string_view returnType;    // 原始的 java 类型
+        std::string_view name;
+        std::string_view parameters;    // 原始的 java 参数列表，比如 int,java.lang.String
+        std::string_view obfuscatedName;
+    };
+
+    struct ClassRecord
+    {
+        std::string_view name;          // 原始的 java 类名，比如 com.foo.Bar$Inner
+        std::string_view obfuscatedName;
+        std::string_view members;       // 这个类的成员行，还没有解析
+    };
+
+    struct Members
+    {
+        std::vector<FieldRecord> fields;
+        std::vector<MethodRecord> methods;
+    };
+
+    const char *mData = nullptr;
+    size_t mLength = 0;
+    bool mOwned = false;                // 文件内容是读进来的而不是 mmap 的
+    std::vector<ClassRecord> mClasses;
+    std::unordered_map<std::string_view, u4> mClassIndex;   // 混淆后的类名 -> mClasses 下标
+
+    // 已经解析过成员的类，守护进程里多个请求会同时查询
+    mutable std::mutex mMembersLock;
+    mutable std::unordered_map<u4, Members> mMembers;
+
+    static void indexRange(const char *begin, const char *end, std::vector<ClassRecord> *out) noexcept;
+
+    static void parseMembers(std::string_view text, Members *out) noexcept;
+
+    [[nodiscard]]
+    const Members &membersOf(const ClassRecord *klass) const noexcept;
+
+    [[nodiscard]]
+    const ClassRecord *findClass(const char *descriptor) const noexcept;
+
+public:
+    explicit ProguardMapping() noexcept = default;
+    ~ProguardMapping() noexcept { close(); }
+
+    NO_COPY(ProguardMapping)
+
+    /**
+     * copy 为 true 时把文件读进自己的内存，而不是 mmap。常驻的守护进程要这样做：
+     * 构建时 mapping.txt 常常被原地覆盖，mmap 的页会跟着变化，文件被截断后再访问还会收到 SIGBUS
+     */
+    int load(const char *path, bool copy = false, size_t threads = 0) noexcept;
+
+    void close() noexcept;
+
+    [[nodiscard]]
+    bool empty() const noexcept { return mClasses.empty(); }
+
+    /**
+     * 还原类描述符、字段类型 (包括数组) 或者方法原型里出现的所有类，
+     * 比如 "[La/b;" -> "[Lcom/foo/Bar;"，"(La/b;)V" -> "(Lcom/foo/Bar;)V"，找不到的类原样保留
+     */
+    [[nodiscard]]
+    std::string deobfuscateType(const char *descriptor) const noexcept;
+
+    /**
+     * 还原字段名。混淆后的名字可能被不同类型的字段复用，所以需要带上 (混淆后的) 类型来区分
+     */
+    [[nodiscard]]
+    std::string deobfuscateField(const char *classDescriptor, const char *name, const char *type) const noexcept;
+
+    /**
+     * 还原方法名，混淆后的名字可能被重载的方法复用，用 (混淆后的) 原型区分
+     */
+    [[nodiscard]]
+    std::string deobfuscateMethod(const char *classDescriptor, const char *name, const char *proto) const noexcept;
+
+    /**
+     * type 以 '(' 开头时按方法处理，否则按字段处理
+     */
+    [[nodiscard]]
+    std::string deobfuscateMember(const char *classDescriptor, const char *name, const char *type) const noexcept
+    {
+        return type[0] == '('
+               ? deobfuscateMethod(classDescriptor, name, type)
+               : deobfuscateField(classDescriptor, name, type);
+    }
+};
+
+#endif // MAPPING_H
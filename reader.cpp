@@ -0,0 +1,301 @@
+
+#include <cerrno>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "reader.h"
+
+PreadReader::~PreadReader() noexcept
+{
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+int PreadReader::open(const char *path) noexcept
+{
+    if ((mFd = ::open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+        return -1;
+    }
+    struct stat st {};
+    if (fstat(mFd, &st) < 0) {
+        return -1;
+    }
+    mLength = (u8) st.st_size;
+    return 0;
+}
+
+size_t PreadReader::read(void *dst, size_t size, u8 offset) noexcept
+{
+    size_t consumed = 0;
+    while (consumed < size) {
+        auto bytes = pread(mFd, (char *) dst + consumed, size - consumed, (off_t) (offset + consumed));
+        if (bytes < 0 && errno == EINTR) continue;
+        if (bytes <= 0) break;
+        consumed += bytes;
+    }
+    return consumed;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * 直接通过系统调用使用 io_uring，不依赖 liburing。
+ * 只有一个线程提交和收割，所以只需要在 tail/head 上做 acquire/release
+ */
+class UringReader : public PreadReader
+{
+private:
+    static constexpr unsigned DEPTH = 256;
+    static constexpr size_t MAX_READ = 1U << 30;    // 单个 sqe 的长度是 32 位的，大 entry 分段读
+
+    int mRingFd = -1;
+    unsigned mDepth = 0;
+
+    void *mSqRing = MAP_FAILED;
+    size_t mSqRingSize = 0;
+    void *mCqRing = MAP_FAILED;
+    size_t mCqRingSize = 0;
+    io_uring_sqe *mSqes = (io_uring_sqe *) MAP_FAILED;
+    size_t mSqesSize = 0;
+
+    unsigned *mSqTail = nullptr;
+    unsigned *mSqMask = nullptr;
+    unsigned *mSqArray = nullptr;
+    unsigned *mCqHead = nullptr;
+    unsigned *mCqTail = nullptr;
+    unsigned *mCqMask = nullptr;
+    io_uring_cqe *mCqes = nullptr;
+
+    void closeRing() noexcept
+    {
+        if (mSqes != MAP_FAILED) munmap(mSqes, mSqesSize);
+        if (mCqRing != MAP_FAILED && mCqRing != mSqRing) munmap(mCqRing, mCqRingSize);
+        if (mSqRing != MAP_FAILED) munmap(mSqRing, mSqRingSize);
+        mSqes = (io_uring_sqe *) MAP_FAILED;
+        mSqRing = mCqRing = MAP_FAILED;
+        if (mRingFd >= 0) ::close(mRingFd);
+        mRingFd = -1;
+    }
+
+    void prepareRead(const Request &r, size_t index) noexcept
+    {
+        unsigned tail = *mSqTail;
+        unsigned slot = tail & *mSqMask;
+        auto sqe = mSqes + slot;
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = mFd;
+        sqe->addr = (u8) (uintptr_t) ((char *) r.dst + r.result);
+        sqe->len = (u4) std::min(r.size - r.result, MAX_READ);
+        sqe->off = r.offset + r.result;
+        sqe->user_data = index;
+        mSqArray[slot] = slot;
+        __atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * 等待所有在飞的请求完成并丢掉它们的结果，失败时返回 false
+     */
+    bool drain(unsigned *inflight) noexcept
+    {
+        while (*inflight > 0) {
+            auto result = syscall(__NR_io_uring_enter, mRingFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+            unsigned head = *mCqHead;
+            unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+            *inflight -= std::min(*inflight, tail - head);
+            __atomic_store_n(mCqHead, tail, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+public:
+    explicit UringReader() noexcept = default;
+    ~UringReader() noexcept override { closeRing(); }
+
+    NO_COPY(UringReader)
+
+    int setup() noexcept
+    {
+        io_uring_params params {};
+        mRingFd = (int) syscall(__NR_io_uring_setup, DEPTH, &params);
+        if (mRingFd < 0) {
+            return -1;
+        }
+        mDepth = params.sq_entries;
+
+        mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+            mSqRingSize = mCqRingSize = std::max(mSqRingSize, mCqRingSize);
+        }
+        mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       mRingFd, IORING_OFF_SQ_RING);
+        if (mSqRing == MAP_FAILED) {
+            closeRing();
+            return -1;
+        }
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+            mCqRing = mSqRing;
+        }
+        else {
+            mCqRing = mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           mRingFd, IORING_OFF_CQ_RING);
+        }
+        mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        mSqes = (io_uring_sqe *) mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                      mRingFd, IORING_OFF_SQES);
+        if (mCqRing == MAP_FAILED || mSqes == MAP_FAILED) {
+            closeRing();
+            return -1;
+        }
+
+        auto sq = (char *) mSqRing, cq = (char *) mCqRing;
+        mSqTail = (unsigned *) (sq + params.sq_off.tail);
+        mSqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+        mSqArray = (unsigned *) (sq + params.sq_off.array);
+        mCqHead = (unsigned *) (cq + params.cq_off.head);
+        mCqTail = (unsigned *) (cq + params.cq_off.tail);
+        mCqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+        mCqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+        return 0;
+    }
+
+    /**
+     * 最多保持 DEPTH 个请求在飞，短读的请求从读到的位置接着提交。
+     * 内核不支持 IORING_OP_READ (5.6 之前) 时这个请求退回到 pread；
+     * io_uring_enter 本身失败时先收割完所有在飞的请求，再关闭 ring，没完成的请求全部用 pread 重新读
+     */
+    void readBatch(Request *requests, size_t count, const OnComplete &onComplete) noexcept override
+    {
+        if (mRingFd < 0) {
+            FileReader::readBatch(requests, count, onComplete);
+            return;
+        }
+        auto complete = [&](size_t index) {
+            if (onComplete) onComplete(index);
+        };
+
+        std::vector<size_t> retry;
+        std::vector<bool> finished(count, false);
+        size_t next = 0;
+        unsigned inflight = 0, unsubmitted = 0;
+
+        while (true) {
+            while (inflight + unsubmitted < mDepth && (!retry.empty() || next < count)) {
+                size_t index;
+                if (!retry.empty()) {
+                    index = retry.back();
+                    retry.pop_back();
+                }
+                else {
+                    index = next++;
+                    requests[index].result = 0;
+                }
+                if (requests[index].size == 0) {
+                    finished[index] = true;
+                    complete(index);
+                    continue;
+                }
+                prepareRead(requests[index], index);
+                unsubmitted += 1;
+            }
+            if (inflight + unsubmitted == 0) {
+                break;
+            }
+
+            auto submitted = syscall(__NR_io_uring_enter, mRingFd, unsubmitted, 1, IORING_ENTER_GETEVENTS,
+                                     nullptr, 0);
+            if (submitted < 0) {
+                // EBUSY 是完成队列满了，要先收割才能继续提交
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+                submitted = 0;
+            }
+            unsubmitted -= (unsigned) submitted;
+            inflight += (unsigned) submitted;
+
+            unsigned head = *mCqHead;
+            unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const auto &cqe = mCqes[head & *mCqMask];
+                auto index = (size_t) cqe.user_data;
+                auto &r = requests[index];
+                inflight -= 1;
+
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    retry.push_back(index);
+                    continue;
+                }
+                if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+                    r.result += read((char *) r.dst + r.result, r.size - r.result, r.offset + r.result);
+                }
+                else if (cqe.res > 0) {
+                    r.result += cqe.res;
+                    if (r.result < r.size) {
+                        retry.push_back(index);
+                        continue;
+                    }
+                }
+                finished[index] = true;
+                complete(index);
+            }
+            __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+        }
+
+        if (inflight + unsubmitted == 0) {
+            return;
+        }
+        // ring 坏了。关闭 ring 不会等在飞的请求，它们晚些完成时还会写缓冲区，
+        // 所以要先把它们的 cqe 全部收割完，之后才能用 pread 重新读同一块缓冲区。
+        // 没提交的 sqe 内核不会去读，不用管
+        bool drained = drain(&inflight);
+        closeRing();
+        for (size_t i = 0; i < count; ++i) {
+            if (finished[i]) continue;
+            // 收割失败时缓冲区可能还会被写，不能再往里读，整批按读取失败处理
+            requests[i].result = drained ? read(requests[i].dst, requests[i].size, requests[i].offset) : 0;
+            complete(i);
+        }
+    }
+};
+
+#endif // HAVE_IO_URING
+
+std::unique_ptr<FileReader> openFileReader(const char *path, IoBackend backend) noexcept
+{
+#ifdef HAVE_IO_URING
+    if (backend != IO_PREAD) {
+        auto reader = std::make_unique<UringReader>();
+        if (reader->open(path) < 0) {
+            return nullptr;
+        }
+        if (reader->setup() == 0) {
+            return reader;
+        }
+        if (backend == IO_URING) {
+            return nullptr;
+        }
+    }
+#else
+    if (backend == IO_URING) {
+        errno = ENOSYS;
+        return nullptr;
+    }
+#endif
+    auto reader = std::make_unique<PreadReader>();
+    if (reader->open(path) < 0) {
+        return nullptr;
+    }
+    return reader;
+}
@@ -0,0 +1,109 @@
+#ifndef READER_H
+#define READER_H
+
+#include <functional>
+#include <memory>
+
+#include "types.h"
+
+enum IoBackend
+{
+    IO_AUTO = 0,    // 编译时启用了 io_uring 并且内核支持时用 io_uring，否则用 pread
+    IO_PREAD,
+    IO_URING,
+};
+
+/**
+ * ZipFile 读取数据的接口，所有读操作都带偏移量，不依赖文件指针的位置
+ */
+class FileReader
+{
+public:
+    struct Request
+    {
+        void *dst;
+        u8 offset;
+        size_t size;
+        size_t result;      // 实际读到的字节数，读到文件末尾或者出错时小于 size
+    };
+
+    /**
+     * 每个请求完成时调用一次，参数是请求的下标。回调和 readBatch 在同一个线程里执行
+     */
+    using OnComplete = std::function<void(size_t)>;
+
+    virtual ~FileReader() noexcept = default;
+
+    [[nodiscard]]
+    virtual u8 length() const noexcept = 0;
+
+    /**
+     * 返回实际读到的字节数
+     */
+    virtual size_t read(void *dst, size_t size, u8 offset) noexcept = 0;
+
+    /**
+     * 批量读取，默认逐个同步读取；io_uring 实现会一次提交多个请求，完成顺序不确定
+     */
+    virtual void readBatch(Request *requests, size_t count, const OnComplete &onComplete = nullptr) noexcept
+    {
+        for (size_t i = 0; i < count; ++i) {
+            requests[i].result = read(requests[i].dst, requests[i].size, requests[i].offset);
+            if (onComplete) onComplete(i);
+        }
+    }
+};
+
+/**
+ * 用 pread 读取磁盘文件
+ */
+class PreadReader : public FileReader
+{
+protected:
+    int mFd = -1;
+    u8 mLength = 0;
+
+public:
+    explicit PreadReader() noexcept = default;
+    ~PreadReader() noexcept override;
+
+    NO_COPY(PreadReader)
+
+    int open(const char *path) noexcept;
+
+    [[nodiscard]]
+    u8 length() const noexcept override { return mLength; }
+
+    size_t read(void *dst, size_t size, u8 offset) noexcept override;
+};
+
+/**
+ * 读取内存里的数据，调用者需要保证 data 在 reader 销毁前一直有效
+ */
+class MemoryReader : public FileReader
+{
+private:
+    const u1 *mData;
+    u8 mLength;
+
+public:
+    explicit MemoryReader(const void *data, size_t length) noexcept : mData((const u1 *) data), mLength(length) {}
+
+    [[nodiscard]]
+    u8 length() const noexcept override { return mLength; }
+
+    size_t read(void *dst, size_t size, u8 offset) noexcept override
+    {
+        if (offset >= mLength) return 0;
+        size = (size_t) std::min<u8>(size, mLength - offset);
+        memcpy(dst, mData + offset, size);
+        return size;
+    }
+};
+
+/**
+ * 打开磁盘文件。IO_AUTO 时优先使用 io_uring，创建 ring 失败 (比如内核太旧或者被 seccomp 禁止) 时退回到 pread
+ */
+std::unique_ptr<FileReader> openFileReader(const char *path, IoBackend backend = IO_AUTO) noexcept;
+
+#endif // READER_H
@@ -0,0 +1,185 @@
+
+#include <algorithm>
+
+#include "dex.h"
+#include "rules.h"
+
+static inline std::pair<MemberTable::const_iterator, MemberTable::const_iterator>
+equalRange(const MemberTable &table, const ResolvedMember &member) noexcept
+{
+    return std::equal_range(table.begin(), table.end(), member, [](const auto &p, const auto &q) {
+        return ResolvedMember::compare(p, q) < 0;
+    });
+}
+
+static inline bool samePackage(const char *p, const char *q) noexcept
+{
+    auto ps = strrchr(p, '/'), qs = strrchr(q, '/');
+    size_t pl = ps == nullptr ? 0 : ps - p;
+    size_t ql = qs == nullptr ? 0 : qs - q;
+    return pl == ql && strncmp(p, q, pl) == 0;
+}
+
+/**
+ * 子类和父类有同名同类型的实例字段
+ */
+class FieldShadowingRule : public HierarchyRule
+{
+public:
+    [[nodiscard]]
+    const char *name() const noexcept override { return "field-shadowing"; }
+
+    void check(const ClassContext &ctx, std::vector<ScanResult> *out) const noexcept override
+    {
+        if (ctx.super == nullptr) {
+            return;
+        }
+        const auto &self = ctx.ownFields;
+        const auto &super = ctx.super->fields;
+        size_t i = 0, j = 0;
+
+        while (i < self.size() && j < super.size()) {
+            int cmp = ResolvedMember::compare(self[i], super[j]);
+            if (cmp < 0) {
+                i += 1;
+            }
+            else if (cmp > 0) {
+                j += 1;
+            }
+            else {
+                out->push_back({ name(), self[i ++], super[j ++] });
+            }
+        }
+    }
+};
+
+/**
+ * 子类的静态方法隐藏了父类同签名的静态方法，调用哪一个取决于引用的静态类型
+ */
+class StaticMethodHidingRule : public HierarchyRule
+{
+public:
+    [[nodiscard]]
+    const char *name() const noexcept override { return "static-method-hiding"; }
+
+    [[nodiscard]]
+    u4 needs() const noexcept override { return NEED_METHODS; }
+
+    void check(const ClassContext &ctx, std::vector<ScanResult> *out) const noexcept override
+    {
+        if (ctx.super == nullptr) {
+            return;
+        }
+        for (const auto &method : ctx.ownMethods) {
+            if ((method.accessFlag & Modifier::ACC_STATIC) == 0) {
+                continue;
+            }
+            auto [begin, end] = equalRange(ctx.super->methods, method);
+            for (auto it = begin; it != end; ++it) {
+                if ((it->accessFlag & Modifier::ACC_STATIC) != 0) {
+                    out->push_back({ name(), method, *it });
+                    break;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * 父类的包级私有方法在另一个包里的子类中有同签名的方法，看起来像重写，实际上并不会重写
+ */
+class PackagePrivateOverrideRule : public HierarchyRule
+{
+public:
+    [[nodiscard]]
+    const char *name() const noexcept override { return "package-private-override"; }
+
+    [[nodiscard]]
+    u4 needs() const noexcept override { return NEED_METHODS; }
+
+    void check(const ClassContext &ctx, std::vector<ScanResult> *out) const noexcept override
+    {
+        if (ctx.super == nullptr) {
+            return;
+        }
+        constexpr u4 visibility = Modifier::ACC_PUBLIC | Modifier::ACC_PROTECTED | Modifier::ACC_PRIVATE;
+        for (const auto &method : ctx.ownMethods) {
+            if ((method.accessFlag & Modifier::ACC_STATIC) != 0) {
+                continue;
+            }
+            // 只看最近的那个声明 (合并时子类自己的排在前面)，中间的类已经重写过的话就不算
+            auto [begin, end] = equalRange(ctx.super->methods, method);
+            if (begin != end
+                && (begin->accessFlag & (visibility | Modifier::ACC_STATIC)) == 0
+                && !samePackage(method.declaredClassName, begin->declaredClassName)) {
+                out->push_back({ name(), method, *begin });
+            }
+        }
+    }
+};
+
+/**
+ * 类的字段和它实现的接口里的常量同名，在类里直接引用这个名字时拿到的是字段而不是常量
+ */
+class InterfaceConstantShadowingRule : public HierarchyRule
+{
+private:
+    void checkFields(const MemberTable &fields, const MemberTable &constants,
+                     std::vector<ScanResult> *out) const noexcept
+    {
+        for (const auto &field : fields) {
+            // 只按名字匹配，类型不同也会被隐藏
+            auto it = std::lower_bound(constants.begin(), constants.end(), field.name,
+                                       [](const auto &p, const char *name) { return strcmp(p.name, name) < 0; });
+            if (it != constants.end() && strcmp(it->name, field.name) == 0
+                && strcmp(it->declaredClassName, field.declaredClassName) != 0) {
+                out->push_back({ name(), field, *it });
+            }
+        }
+    }
+
+public:
+    [[nodiscard]]
+    const char *name() const noexcept override { return "interface-constant-shadowing"; }
+
+    [[nodiscard]]
+    u4 needs() const noexcept override { return NEED_INTERFACES; }
+
+    void check(const ClassContext &ctx, std::vector<ScanResult> *out) const noexcept override
+    {
+        if (ctx.interfaceConstants.empty()) {
+            return;
+        }
+        checkFields(ctx.ownFields, ctx.interfaceConstants, out);
+        checkFields(ctx.ownStaticFields, ctx.interfaceConstants, out);
+    }
+};
+
+const std::vector<const HierarchyRule *> &allRules() noexcept
+{
+    static const FieldShadowingRule fieldShadowing;
+    static const StaticMethodHidingRule staticMethodHiding;
+    static const PackagePrivateOverrideRule packagePrivateOverride;
+    static const InterfaceConstantShadowingRule interfaceConstantShadowing;
+
+    static const std::vector<const HierarchyRule *> rules = {
+            &fieldShadowing,
+            &staticMethodHiding,
+            &packagePrivateOverride,
+            &interfaceConstantShadowing,
+    };
+    return rules;
+}
+
+const HierarchyRule *defaultRule() noexcept
+{
+    return allRules().front();
+}
+
+const HierarchyRule *findRule(const std::string &name) noexcept
+{
+    for (auto rule : allRules()) {
+        if (name == rule->name()) return rule;
+    }
+    return nullptr;
+}
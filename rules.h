@@ -0,0 +1,100 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * 解析后的字段或方法。字段的 type 是类型描述符 ("I")，方法的 type 是原型描述符 ("(I)V")
+ */
+struct ResolvedMember
+{
+    u4 accessFlag;
+    const char *name;
+    const char *type;
+    const char *declaredClassName;
+
+    [[nodiscard]]
+    bool isMethod() const noexcept { return type[0] == '('; }
+
+    static int compare(const ResolvedMember &p, const ResolvedMember &q) noexcept
+    {
+        if (&p == &q) return 0;
+
+        int cmp = strcmp(p.name, q.name);
+        if (cmp != 0) return cmp;
+
+        cmp = strcmp(p.type, q.type);
+        return cmp;
+    }
+};
+
+/**
+ * 一条扫描结果：子类里的成员和父类 (或接口) 里与之冲突的成员
+ */
+struct ScanResult
+{
+    const char *rule;
+    ResolvedMember self;
+    ResolvedMember other;
+};
+
+using MemberTable = std::vector<ResolvedMember>;   // 按 (name, type) 排序
+
+/**
+ * 一个类解析完成后留给子类使用的成员表
+ */
+struct ResolvedClass
+{
+    MemberTable fields;                 // 自身及继承来的实例字段
+    MemberTable staticFields;           // 自身的静态字段
+    MemberTable methods;                // 自身及继承来的方法
+    MemberTable interfaceConstants;     // 自身、父类、父接口实现的所有接口里的静态字段
+};
+
+/**
+ * 规则检查一个类时能看到的信息。父类不在 apk 里 (比如 framework 里的类) 时 super 为 nullptr
+ */
+struct ClassContext
+{
+    const char *className;
+    const MemberTable &ownFields;
+    const MemberTable &ownStaticFields;
+    const MemberTable &ownMethods;
+    const MemberTable &interfaceConstants;
+    const ResolvedClass *super;
+};
+
+/**
+ * 基于类继承关系的检查规则。所有启用的规则在同一次遍历里执行，
+ * 解压、建索引和解析父类只需要做一次
+ */
+class HierarchyRule
+{
+public:
+    static constexpr u4 NEED_METHODS = 0x1;     // 需要解析方法表
+    static constexpr u4 NEED_INTERFACES = 0x2;  // 需要解析实现的接口和静态字段
+
+    virtual ~HierarchyRule() noexcept = default;
+
+    [[nodiscard]]
+    virtual const char *name() const noexcept = 0;
+
+    [[nodiscard]]
+    virtual u4 needs() const noexcept { return 0; }
+
+    virtual void check(const ClassContext &ctx, std::vector<ScanResult> *out) const noexcept = 0;
+};
+
+/**
+ * 内置的所有规则，第一个 (field-shadowing) 是默认规则
+ */
+const std::vector<const HierarchyRule *> &allRules() noexcept;
+
+const HierarchyRule *defaultRule() noexcept;
+
+const HierarchyRule *findRule(const std::string &name) noexcept;
+
+#endif // RULES_H
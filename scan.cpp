@@ -0,0 +1,162 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "scan.h"
+
+struct OptionSpec
+{
+    const char *name;
+    bool hasValue;
+    bool isPath;
+};
+
+static const OptionSpec OPTIONS[] = {
+        { "--include", true, false },
+        { "--exclude", true, false },
+        { "--baseline", true, true },
+        { "--fail-fast", false, false },
+        { "--mapping", true, true },
+        { "--rules", true, false },
+        { "--io", true, false },
+};
+
+static const OptionSpec *findOption(const std::string &name) noexcept
+{
+    for (const auto &it : OPTIONS) {
+        if (name == it.name) return &it;
+    }
+    return nullptr;
+}
+
+static inline bool isOption(const std::string &arg) noexcept
+{
+    return arg.size() > 2 && arg.compare(0, 2, "--") == 0;
+}
+
+static int parseRules(const std::string &value, std::vector<const HierarchyRule *> *rules,
+                      std::string *error) noexcept
+{
+    if (value == "all") {
+        *rules = allRules();
+        return 0;
+    }
+    size_t start = 0;
+    while (start <= value.size()) {
+        auto end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        auto name = value.substr(start, end - start);
+        start = end + 1;
+        if (name.empty()) {
+            continue;
+        }
+        auto rule = findRule(name);
+        if (rule == nullptr) {
+            *error = "unknown rule '" + name + "'";
+            return -1;
+        }
+        if (std::find(rules->begin(), rules->end(), rule) == rules->end()) {
+            rules->push_back(rule);
+        }
+    }
+    return 0;
+}
+
+std::shared_ptr<const ProguardMapping> loadMapping(const std::string &path, bool copy) noexcept
+{
+    auto mapping = std::make_shared<ProguardMapping>();
+    if (mapping->load(path.c_str(), copy) < 0) {
+        return nullptr;
+    }
+    return mapping;
+}
+
+int parseScanArgs(const std::vector<std::string> &args, ScanArgs *out, std::string *error,
+                  const MappingLoader &loader) noexcept
+{
+    for (size_t i = 0, n = args.size(); i < n; ++i) {
+        const auto &arg = args[i];
+        if (!isOption(arg)) {
+            out->paths.push_back(arg);
+            continue;
+        }
+        auto spec = findOption(arg);
+        if (spec == nullptr) {
+            *error = "unknown option '" + arg + "'";
+            return -1;
+        }
+        if (spec->hasValue && i + 1 >= n) {
+            *error = "option '" + arg + "' requires a value";
+            return -1;
+        }
+
+        if (arg == "--include") {
+            out->filter.include(args[++i]);
+        }
+        else if (arg == "--exclude") {
+            out->filter.exclude(args[++i]);
+        }
+        else if (arg == "--baseline") {
+            const auto &path = args[++i];
+            if (out->baseline.load(path.c_str()) < 0) {
+                *error = "failed to load baseline '" + path + "': " + strerror(errno);
+                return -1;
+            }
+            out->hasBaseline = true;
+        }
+        else if (arg == "--fail-fast") {
+            out->failFast = true;
+        }
+        else if (arg == "--rules") {
+            if (parseRules(args[++i], &out->rules, error) < 0) {
+                return -1;
+            }
+        }
+        else if (arg == "--io") {
+            const auto &value = args[++i];
+            if (value == "auto") out->io = IO_AUTO;
+            else if (value == "uring") out->io = IO_URING;
+            else if (value == "pread") out->io = IO_PREAD;
+            else {
+                *error = "unknown io backend '" + value + "'";
+                return -1;
+            }
+        }
+        else if (arg == "--mapping") {
+            const auto &path = args[++i];
+            out->mapping = loader ? loader(path) : loadMapping(path);
+            if (out->mapping == nullptr) {
+                *error = "failed to load mapping '" + path + "': " + strerror(errno);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void absolutize(std::string *path) noexcept
+{
+    char buff[PATH_MAX];
+    if (realpath(path->c_str(), buff) != nullptr) {
+        *path = buff;
+    }
+}
+
+void absolutizeScanArgs(std::vector<std::string> *args) noexcept
+{
+    for (size_t i = 0, n = args->size(); i < n; ++i) {
+        auto &arg = (*args)[i];
+        if (!isOption(arg)) {
+            absolutize(&arg);
+            continue;
+        }
+        auto spec = findOption(arg);
+        if (spec != nullptr && spec->hasValue && i + 1 < n) {
+            if (spec->isPath) absolutize(&(*args)[i + 1]);
+            i += 1;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "apk.h"
+#include "baseline.h"
+#include "filter.h"
+#include "mapping.h"
+
+/**
+ * 一次扫描的参数，命令行和守护进程的请求共用同一套格式：
+ *   [--include pattern]... [--exclude pattern]... [--baseline file] [--fail-fast] [--mapping file]
+ *   [--rules name,...|all] [--io auto|uring|pread] [apkPath...]
+ */
+struct ScanArgs
+{
+    std::vector<std::string> paths;
+    ClassFilter filter;
+    Baseline baseline;
+    bool hasBaseline = false;   // 空的 baseline 文件也算指定了 baseline
+    bool failFast = false;
+    std::shared_ptr<const ProguardMapping> mapping;
+    std::vector<const HierarchyRule *> rules;
+    IoBackend io = IO_AUTO;
+
+    [[nodiscard]]
+    ScanOptions toScanOptions() const noexcept
+    {
+        ScanOptions options;
+        options.filter = filter.empty() ? nullptr : &filter;
+        options.baseline = baseline.empty() ? nullptr : &baseline;
+        options.failFast = failFast;
+        options.mapping = mapping == nullptr || mapping->empty() ? nullptr : mapping.get();
+        options.rules = rules;
+        return options;
+    }
+
+    /**
+     * 有新问题时的退出码：只有指定了 baseline 或者 fail-fast 时才让调用方 (比如 CI) 失败
+     */
+    [[nodiscard]]
+    int exitCodeFor(size_t findings) const noexcept
+    {
+        return findings > 0 && (failFast || hasBaseline) ? 2 : 0;
+    }
+};
+
+/**
+ * 加载 --mapping 指定的文件，失败时返回 nullptr 并设置 errno。守护进程会换成带缓存的实现，
+ * 并且把文件读进内存 (copy)，不依赖 mmap
+ */
+using MappingLoader = std::function<std::shared_ptr<const ProguardMapping>(const std::string &path)>;
+
+std::shared_ptr<const ProguardMapping> loadMapping(const std::string &path, bool copy = false) noexcept;
+
+/**
+ * 出错时返回 -1，并把原因写到 error 里。loader 为空时直接用 loadMapping 加载 mapping
+ */
+int parseScanArgs(const std::vector<std::string> &args, ScanArgs *out, std::string *error,
+                  const MappingLoader &loader = nullptr) noexcept;
+
+/**
+ * 把参数里的文件路径转成绝对路径，用于把请求转发给工作目录不同的守护进程
+ */
+void absolutizeScanArgs(std::vector<std::string> *args) noexcept;
+
+#endif // SCAN_H
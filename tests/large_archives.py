@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""
+生成两个大 zip 并检查扫描结果：
+  - 稀疏文件，dex 位于 5 GB 偏移处，只能通过 zip64 eocd locator/record 和 zip64 extra 找到
+  - 超过 65535 个 entry 的 zip，条目数只记录在 zip64 eocd record 里
+
+usage: large_archives.py <SuperChain> <workDir>
+"""
+
+import hashlib
+import os
+import struct
+import subprocess
+import sys
+import zipfile
+import zlib
+
+
+def uleb(v):
+    out = b''
+    while True:
+        b = v & 0x7f
+        v >>= 7
+        if v == 0:
+            return out + bytes([b])
+        out += bytes([b | 0x80])
+
+
+def gendex(classes):
+    """
+    只带实例字段的最小 dex。classes: [(name, super, [(fieldName, fieldType)])]
+    """
+    strings = set()
+    for name, sup, fields in classes:
+        strings.update((name, sup))
+        for f in fields:
+            strings.update(f)
+    strings = sorted(strings)
+    sidx = {s: i for i, s in enumerate(strings)}
+    types = sorted({t for c in classes for t in (c[0], c[1])} | {f[1] for c in classes for f in c[2]},
+                   key=lambda t: sidx[t])
+    tidx = {t: i for i, t in enumerate(types)}
+    fields = sorted({(c[0], f[1], f[0]) for c in classes for f in c[2]},
+                    key=lambda f: (tidx[f[0]], sidx[f[2]], tidx[f[1]]))
+    fidx = {f: i for i, f in enumerate(fields)}
+
+    header_size = 0x70
+    string_ids_off = header_size
+    type_ids_off = string_ids_off + 4 * len(strings)
+    field_ids_off = type_ids_off + 4 * len(types)
+    class_defs_off = field_ids_off + 8 * len(fields)
+    data_off = class_defs_off + 32 * len(classes)
+
+    data = b''
+    string_offs = []
+    for s in strings:
+        string_offs.append(data_off + len(data))
+        data += uleb(len(s)) + s.encode() + b'\0'
+    class_data_offs = []
+    for name, _, own in classes:
+        class_data_offs.append(data_off + len(data))
+        indexes = sorted(fidx[(name, f[1], f[0])] for f in own)
+        data += uleb(0) + uleb(len(indexes)) + uleb(0) + uleb(0)
+        prev = 0
+        for i in indexes:
+            data += uleb(i - prev) + uleb(1)     # ACC_PUBLIC
+            prev = i
+
+    body = b''.join(struct.pack('<I', o) for o in string_offs)
+    body += b''.join(struct.pack('<I', sidx[t]) for t in types)
+    body += b''.join(struct.pack('<HHI', tidx[f[0]], tidx[f[1]], sidx[f[2]]) for f in fields)
+    for (name, sup, _), off in zip(classes, class_data_offs):
+        body += struct.pack('<8I', tidx[name], 1, tidx[sup], 0, 0xffffffff, 0, off, 0)
+
+    header = b'dex\n035\0' + struct.pack('<I', 0) + hashlib.sha1(body + data).digest()
+    header += struct.pack('<6I', header_size + len(body) + len(data), header_size, 0x12345678, 0, 0, 0)
+    header += struct.pack('<12I', len(strings), string_ids_off, len(types), type_ids_off, 0, 0,
+                          len(fields), field_ids_off, 0, 0, len(classes), class_defs_off)
+    header += struct.pack('<II', len(data), data_off)
+    return header + body + data
+
+
+BASE_DEX = gendex([
+    ('Lcom/ourco/Base;', 'Ljava/lang/Object;', [('a', 'I')]),
+    ('Lcom/ourco/Child;', 'Lcom/ourco/Base;', [('a', 'I'), ('b', 'I')]),
+])
+DEEP_DEX = gendex([
+    ('Lcom/ourco/Deep;', 'Lcom/ourco/Child;', [('b', 'I')]),
+])
+
+
+def write_sparse(path, offset):
+    """
+    手写 zip64 结构：local header 在 offset 处，cde 里的大小和偏移量都是 0xFFFFFFFF，
+    真实值放在 zip64 extra 里，eocd 里的条目数和目录位置也都交给 zip64 eocd record
+    """
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+    data = compressor.compress(BASE_DEX) + compressor.flush()
+    crc = zlib.crc32(BASE_DEX)
+    name = b'classes.dex'
+    with open(path, 'wb') as f:
+        f.seek(offset)
+        f.write(struct.pack('<IHHHHHIIIHH', 0x04034b50, 45, 0, 8, 0, 0, crc, len(data), len(BASE_DEX),
+                            len(name), 0) + name + data)
+        directory = f.tell()
+        extra = struct.pack('<HHQQQ', 1, 24, len(BASE_DEX), len(data), offset)
+        f.write(struct.pack('<IHHHHHHIIIHHHHHII', 0x02014b50, 45, 45, 0, 8, 0, 0, crc, 0xffffffff,
+                            0xffffffff, len(name), len(extra), 0, 0, 0, 0, 0xffffffff) + name + extra)
+        directory_size = f.tell() - directory
+        eocd64 = f.tell()
+        f.write(struct.pack('<IQHHIIQQQQ', 0x06064b50, 44, 45, 45, 0, 0, 1, 1, directory_size, directory))
+        f.write(struct.pack('<IIQI', 0x07064b50, 0, eocd64, 1))
+        f.write(struct.pack('<IHHHHIIH', 0x06054b50, 0, 0, 0xffff, 0xffff, 0xffffffff, 0xffffffff, 0))
+
+
+def write_many(path, count):
+    with zipfile.ZipFile(path, 'w', zipfile.ZIP_DEFLATED) as z:
+        z.writestr('classes.dex', BASE_DEX)
+        for i in range(count):
+            z.writestr('res/raw/r%d' % i, b'')
+        z.writestr('classes2.dex', DEEP_DEX)
+
+
+def scan(binary, path):
+    result = subprocess.run([binary, path], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                            universal_newlines=True)
+    lines = [line for line in result.stdout.splitlines() if "' <==> '" in line]
+    return result.returncode, sorted(lines)
+
+
+def check(binary, path, expected):
+    code, lines = scan(binary, path)
+    if code != 0 or lines != sorted(expected):
+        print('FAIL %s: exit %d' % (path, code))
+        print('  expected: %s' % sorted(expected))
+        print('  actual:   %s' % lines)
+        return False
+    print('ok %s' % path)
+    return True
+
+
+def main():
+    binary, work_dir = sys.argv[1], sys.argv[2]
+    os.makedirs(work_dir, exist_ok=True)
+
+    sparse = os.path.join(work_dir, 'sparse.apk')
+    many = os.path.join(work_dir, 'many.apk')
+    write_sparse(sparse, 5 << 30)
+    write_many(many, 70000)
+
+    ok = check(binary, sparse, [
+        "Lcom/ourco/Child;->a:I' <==> 'Lcom/ourco/Base;->a:I",
+    ])
+    ok = check(binary, many, [
+        "Lcom/ourco/Child;->a:I' <==> 'Lcom/ourco/Base;->a:I",
+        "Lcom/ourco/Deep;->b:I' <==> 'Lcom/ourco/Child;->b:I",
+    ]) and ok
+
+    for path in (sparse, many):
+        os.remove(path)
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
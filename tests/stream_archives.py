@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+生成只能按 local header 顺序读取的 zip，通过管道传给 `SuperChain -` 并检查结果：
+  - 带 data descriptor 的 entry，普通的和 zip64 的
+  - 中央目录前面的 apk 签名块
+  - 未压缩又带 data descriptor 的 entry 必须被拒绝
+  - 中途被截断的流必须失败
+
+usage: stream_archives.py <SuperChain>
+"""
+
+import struct
+import subprocess
+import sys
+import zlib
+
+# 不在源码目录里留下 __pycache__
+sys.dont_write_bytecode = True
+from large_archives import BASE_DEX, DEEP_DEX
+
+DEFLATE = 8
+STORE = 0
+FLAG_DATA_DESCRIPTOR = 0x08
+
+FINDINGS = [
+    "Lcom/ourco/Child;->a:I' <==> 'Lcom/ourco/Base;->a:I",
+    "Lcom/ourco/Deep;->b:I' <==> 'Lcom/ourco/Child;->b:I",
+]
+
+
+def build_zip(entries, descriptor=False, zip64=False, signing_block=False):
+    """
+    entries: [(name, data, method)]。descriptor 为 True 时 local header 里的 crc 和大小都是 0，
+    真实值放在数据后面的 data descriptor 里；zip64 时 local header 带 zip64 extra，descriptor 里的大小是 8 字节
+    """
+    out = b''
+    directory = b''
+    for i, (name, data, method) in enumerate(entries):
+        name = name.encode()
+        if method == DEFLATE:
+            compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+            body = compressor.compress(data) + compressor.flush()
+        else:
+            body = data
+        crc = zlib.crc32(data)
+        flag = FLAG_DATA_DESCRIPTOR if descriptor else 0
+        local_crc, local_sizes = (0, (0, 0)) if descriptor else (crc, (len(body), len(data)))
+        extra = b''
+        if zip64:
+            extra = struct.pack('<HHQQ', 1, 16, *((0, 0) if descriptor else (len(data), len(body))))
+            local_sizes = (0xffffffff, 0xffffffff)
+        offset = len(out)
+        out += struct.pack('<IHHHHHIIIHH', 0x04034b50, 45, flag, method, 0, 0, local_crc, *local_sizes,
+                           len(name), len(extra)) + name + extra + body
+        if descriptor:
+            # 签名是可选的，交替写带签名和不带签名的
+            signature = struct.pack('<I', 0x08074b50) if i % 2 == 0 else b''
+            sizes = struct.pack('<QQ' if zip64 else '<II', len(body), len(data))
+            out += signature + struct.pack('<I', crc) + sizes
+        directory += struct.pack('<IHHHHHHIIIHHHHHII', 0x02014b50, 45, 45, flag, method, 0, 0, crc, len(body),
+                                 len(data), len(name), 0, 0, 0, 0, 0, offset) + name
+
+    if signing_block:
+        pairs = struct.pack('<QI', 4 + 32, 0x7109871a) + b'\x5a' * 32
+        size = len(pairs) + 8 + 16
+        out += struct.pack('<Q', size) + pairs + struct.pack('<Q', size) + b'APK Sig Block 42'
+
+    directory_offset = len(out)
+    out += directory
+    out += struct.pack('<IHHHHIIH', 0x06054b50, 0, 0, len(entries), len(entries), len(directory),
+                       directory_offset, 0)
+    return out
+
+
+def scan(binary, data):
+    result = subprocess.run([binary, '-'], input=data, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    lines = [line for line in result.stdout.decode().splitlines() if "' <==> '" in line]
+    return result.returncode, sorted(lines)
+
+
+def check(binary, label, data, expected_code, expected=()):
+    code, lines = scan(binary, data)
+    if code != expected_code or lines != sorted(expected):
+        print('FAIL %s: exit %d, expected %d' % (label, code, expected_code))
+        print('  expected: %s' % sorted(expected))
+        print('  actual:   %s' % lines)
+        return False
+    print('ok %s' % label)
+    return True
+
+
+def main():
+    binary = sys.argv[1]
+    dexes = [
+        ('res/raw/blob', b'\0' * 4096, DEFLATE),
+        ('classes.dex', BASE_DEX, DEFLATE),
+        ('classes2.dex', DEEP_DEX, DEFLATE),
+    ]
+    descriptor = build_zip(dexes, descriptor=True)
+
+    ok = check(binary, 'deflate + data descriptor', descriptor, 0, FINDINGS)
+    ok = check(binary, 'deflate + zip64 data descriptor', build_zip(dexes, descriptor=True, zip64=True),
+               0, FINDINGS) and ok
+    ok = check(binary, 'apk signing block', build_zip(dexes, signing_block=True), 0, FINDINGS) and ok
+    ok = check(binary, 'data descriptor + apk signing block',
+               build_zip(dexes, descriptor=True, signing_block=True), 0, FINDINGS) and ok
+
+    # 未压缩的 entry 只能靠扫描签名找到 descriptor，不管是不是 dex 都要拒绝，而不是读出错位的数据
+    ok = check(binary, 'stored dex + data descriptor',
+               build_zip([('classes.dex', BASE_DEX, STORE)], descriptor=True), 1) and ok
+    ok = check(binary, 'stored resource + data descriptor',
+               build_zip([('res/raw/blob', b'\0' * 64, STORE)] + dexes[1:], descriptor=True), 1) and ok
+
+    # 截断在 dex 数据中间，以及截断在中央目录之前 (最后一个 entry 完整)
+    directory_offset = struct.unpack('<I', descriptor[-6:-2])[0]
+    ok = check(binary, 'truncated inside an entry', descriptor[:len(descriptor) // 2], 1) and ok
+    ok = check(binary, 'truncated before the central directory', descriptor[:directory_offset], 1) and ok
+    ok = check(binary, 'empty stream', b'', 1) and ok
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
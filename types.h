@@ -3,6 +3,8 @@
 #define TYPES_H
 
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
 
 using u1 = uint8_t;
 using u2 = uint16_t;
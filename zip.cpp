@@ -2,23 +2,17 @@
 
 #include <memory>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <zlib.h>
 
 #include "zip.h"
 
-static size_t readFully(FILE *fp, void *dst, size_t size) noexcept
-{
-    size_t consumed = 0;
-    while (consumed < size && !feof(fp) && !ferror(fp)) {
-        auto bytes = fread((char *) dst + consumed, 1, size - consumed, fp);
-        if (bytes == -1) break;
-        consumed += bytes;
-    }
-    return consumed;
-}
-
 struct EOCD
 {
     static constexpr u4 MAGIC = 0x06054b50;
@@ -33,6 +27,30 @@ struct EOCD
     char comment[0];
 } __attribute__((packed));
 
+struct EOCD64Locator
+{
+    static constexpr u4 MAGIC = 0x07064b50;
+    u4 magic;
+    u4 eocdDiskNumber;
+    u8 eocdOffset;
+    u4 totalDisks;
+} __attribute__((packed));
+
+struct EOCD64
+{
+    static constexpr u4 MAGIC = 0x06064b50;
+    u4 magic;
+    u8 recordSize;
+    u2 versionMadeBy;
+    u2 versionToExtract;
+    u4 diskNumber;
+    u4 startDiskNumber;
+    u8 entriesOnDisk;
+    u8 entriesInDirectory;
+    u8 directorySize;
+    u8 directoryOffset;
+} __attribute__((packed));
+
 struct CDE
 {
     static constexpr u4 MAGIC = 0x02014b50;
@@ -88,40 +106,91 @@ struct LFH
     u2 extraLength;
 } __attribute__((packed));
 
-static inline const char *readString(FILE *file, u2 len) noexcept
+static inline const char *copyString(const u1 *src, u2 len) noexcept
 {
     if (len == 0) {
         return nullptr;
     }
     auto buff = new char[len + 1];
-    fread(buff, 1, len, file);
+    memcpy(buff, src, len);
     buff[len] = '\0';
     return buff;
 }
 
-int ZipFile::open(const char *path) noexcept
+/**
+ * 解析 zip64 extended information extra field (header id 0x0001)。
+ * 只有在 cde 里对应字段被置为 0xFFFFFFFF 时，extra 里才会按顺序出现 8 字节的真实值
+ */
+static int readZip64Extra(ZipEntry *e, const CDE &cde) noexcept
+{
+    static constexpr u2 ZIP64_EXTRA_ID = 0x0001;
+    static constexpr u4 ZIP64_MARK = 0xFFFFFFFF;
+
+    bool needUnCompressedSize = cde.unCompressedSize == ZIP64_MARK;
+    bool needCompressedSize = cde.compressedSize == ZIP64_MARK;
+    bool needOffset = cde.headerOffset == ZIP64_MARK;
+    if (!needUnCompressedSize && !needCompressedSize && !needOffset) {
+        return 0;
+    }
+
+    BytesInput input(e->extra, e->extra == nullptr ? 0 : e->extraLength);
+    while (input.where() + 4 <= input.length()) {
+        u2 id = 0, size = 0;
+        input >> id >> size;
+        size_t next = input.where() + size;
+
+        if (id == ZIP64_EXTRA_ID) {
+            if (needUnCompressedSize) input >> e->unCompressedSize;
+            if (needCompressedSize) input >> e->compressedSize;
+            if (needOffset) input >> e->bytesOffset;
+            return input.where() <= next ? 0 : -1;
+        }
+        input.seek(next);
+    }
+    return -1;
+}
+
+int ZipFile::open(const char *path, IoBackend backend) noexcept
 {
-    if ((mFile = fopen(path, "rb")) == nullptr) {
+    if ((mReader = openFileReader(path, backend)) == nullptr) {
         return -1;
     }
-    fseek(mFile, 0, SEEK_END);
-    auto fileSize = ftell(mFile);
+    return parse(0, mReader->length());
+}
 
-    long buffLength = 64 * 1024 + sizeof(EOCD);
+int ZipFile::open(const ZipFile &outer, u8 offset, u8 length) noexcept
+{
+    if ((mReader = outer.mReader) == nullptr || offset + length > mReader->length()) {
+        return -1;
+    }
+    return parse(offset, length);
+}
+
+int ZipFile::open(const void *data, size_t length) noexcept
+{
+    mReader = std::make_shared<MemoryReader>(data, length);
+    return parse(0, length);
+}
+
+int ZipFile::parse(u8 base, u8 length) noexcept
+{
+    u8 buffLength = std::min<u8>(64 * 1024 + sizeof(EOCD), length);
     auto buff = std::make_unique<char[]>(buffLength);
 
-    fseek(mFile, - std::min(buffLength, fileSize), SEEK_CUR);
-    buffLength = (long) fread(buff.get(), 1, buffLength, mFile);
+    u8 buffStart = base + length - buffLength;
+    buffLength = mReader->read(buff.get(), buffLength, buffStart);
 
     EOCD *eocd = nullptr;
+    u8 eocdOffset = 0;
 
-    for (long i = buffLength - sizeof(EOCD); i >= 0; --i) {
+    for (off_t i = (off_t) buffLength - (off_t) sizeof(EOCD); i >= 0; --i) {
         auto tmp = (EOCD *) (buff.get() + i);
         if (tmp->magic == EOCD::MAGIC
             && tmp->diskNumber == 0
             && tmp->startDiskNumber == 0
             && tmp->entriesOnDisk == tmp->entriesInDirectory) {
             eocd = tmp;
+            eocdOffset = buffStart + i;
             break;
         }
     }
@@ -129,43 +198,83 @@ int ZipFile::open(const char *path) noexcept
         return -1;
     }
 
-    mSize = eocd->entriesOnDisk;
-    mEntries = new ZipEntry[mSize];
+    u8 entries = eocd->entriesOnDisk;
+    u8 directoryOffset = eocd->directoryOffset;
+    u8 directorySize = eocd->directorySize;
 
-    if (eocd->commentLength > 0) {
-        mComment = new char[eocd->commentLength + 1];
-        memcpy((void *) mComment, eocd->comment, eocd->commentLength);
+    // zip64: 紧挨着 eocd 前面的是 zip64 eocd locator，由它找到 zip64 eocd，里面才是真实的条目数和偏移量
+    EOCD64Locator locator {};
+    if (eocdOffset - base >= sizeof(EOCD64Locator)) {
+        mReader->read(&locator, sizeof(EOCD64Locator), eocdOffset - sizeof(EOCD64Locator));
+    }
+    if (locator.magic == EOCD64Locator::MAGIC) {
+        EOCD64 eocd64 {};
+        mReader->read(&eocd64, sizeof(EOCD64), base + locator.eocdOffset);
+        if (eocd64.magic != EOCD64::MAGIC
+            || eocd64.diskNumber != 0
+            || eocd64.startDiskNumber != 0
+            || eocd64.entriesOnDisk != eocd64.entriesInDirectory) {
+            return -1;
+        }
+        entries = eocd64.entriesOnDisk;
+        directoryOffset = eocd64.directoryOffset;
+        directorySize = eocd64.directorySize;
+    }
+    if (directoryOffset + directorySize > length || entries > directorySize / sizeof(CDE)) {
+        return -1;
     }
 
-    fseek(mFile, eocd->directoryOffset, SEEK_SET);
+    mSize = entries;
+    mEntries = new ZipEntry[mSize]{};
+
+    if (eocd->commentLength > 0) {
+        mComment = copyString((const u1 *) eocd->comment, eocd->commentLength);
+    }
 
-    // 遍历 cde 里的每个 entry，收集数据
-    CDE cde{};
-    for (int i = 0; i < eocd->entriesOnDisk; i ++) {
-        fread(&cde, 1, sizeof(CDE), mFile);
-        if (cde.magic != CDE::MAGIC) {
+    // 整个中央目录一次读进来，再在内存里遍历每个 entry，收集数据
+    auto directory = std::make_unique<u1[]>(directorySize);
+    if (mReader->read(directory.get(), directorySize, base + directoryOffset) != directorySize) {
+        return -1;
+    }
+    CDE cde {};
+    u8 pos = 0;
+    for (size_t i = 0; i < mSize; i ++) {
+        if (pos + sizeof(CDE) > directorySize) {
+            return -1;
+        }
+        memcpy(&cde, directory.get() + pos, sizeof(CDE));
+        pos += sizeof(CDE);
+        if (cde.magic != CDE::MAGIC || pos + cde.nameLength + cde.extraLength + cde.commentLength > directorySize) {
             return -1;
         }
         auto e = mEntries + i;
         cde.copyTo(e);
         e->bytesOffset = cde.headerOffset;
-        e->name = readString(mFile, e->nameLength);
-        e->extra = readString(mFile, e->extraLength);
-        e->comment = readString(mFile, e->commentLength);
-        cde.magic = 0;
+        e->name = copyString(directory.get() + pos, e->nameLength);
+        pos += e->nameLength;
+        e->extra = copyString(directory.get() + pos, e->extraLength);
+        pos += e->extraLength;
+        e->comment = copyString(directory.get() + pos, e->commentLength);
+        pos += e->commentLength;
+        if (readZip64Extra(e, cde) != 0) {
+            return -1;
+        }
     }
-    // 再次遍历每个 entry，修正 cde
-    LFH lfh {};
-    for (int i = 0; i < eocd->entriesOnDisk; i ++) {
-        auto e = mEntries + i;
-        fseek(mFile, e->bytesOffset, SEEK_SET);
+    directory.reset();
 
-        fread(&lfh, 1, sizeof(LFH), mFile);
-        if (lfh.magic != LFH::MAGIC) {
+    // 再读每个 entry 的 local file header 修正数据的偏移量，这些小读请求一起提交
+    auto headers = std::make_unique<LFH[]>(mSize);
+    std::vector<FileReader::Request> requests(mSize);
+    for (size_t i = 0; i < mSize; i ++) {
+        requests[i] = { headers.get() + i, base + mEntries[i].bytesOffset, sizeof(LFH), 0 };
+    }
+    mReader->readBatch(requests.data(), requests.size());
+    for (size_t i = 0; i < mSize; i ++) {
+        const auto &lfh = headers[i];
+        if (requests[i].result != sizeof(LFH) || lfh.magic != LFH::MAGIC) {
             return -1;
         }
-        fseek(mFile, lfh.extraLength + lfh.nameLength, SEEK_CUR);
-        e->bytesOffset = ftell(mFile);
+        mEntries[i].bytesOffset = requests[i].offset + sizeof(LFH) + lfh.nameLength + lfh.extraLength;
     }
 
     return 0;
@@ -173,11 +282,10 @@ int ZipFile::open(const char *path) noexcept
 
 void ZipFile::close() noexcept
 {
-    if (mFile == nullptr) {
+    if (mReader == nullptr) {
         return;
     }
-    fclose(mFile);
-    mFile = nullptr;
+    mReader.reset();
 
     delete[] mComment;
     mComment = nullptr;
@@ -202,9 +310,7 @@ static int uncompressRaw(void *dst, size_t dstLen, const void *src, size_t srcLe
 {
     z_stream stream{};
     stream.next_in = (Bytef*) src;
-    stream.avail_in = (uInt) srcLen;
     stream.next_out = (Bytef *) dst;
-    stream.avail_out = (uInt) dstLen;
     stream.zalloc = Z_NULL;
     stream.zfree = Z_NULL;
     stream.opaque = Z_NULL;
@@ -214,35 +320,390 @@ static int uncompressRaw(void *dst, size_t dstLen, const void *src, size_t srcLe
     std::unique_ptr<z_stream, void (*)(z_stream *)> streamGuard(
             &stream, [](z_stream *p) { inflateEnd(p); });
 
-    auto result = inflate(&stream, Z_FINISH);
+    // avail_in/avail_out 只有 32 位，超过 4G 的 entry 需要分段喂给 zlib
+    constexpr size_t kMaxChunk = std::numeric_limits<uInt>::max();
+    int result;
+    do {
+        size_t inLeft = srcLen - ((const char *) stream.next_in - (const char *) src);
+        size_t outLeft = dstLen - ((char *) stream.next_out - (char *) dst);
+        stream.avail_in = (uInt) std::min(inLeft, kMaxChunk);
+        stream.avail_out = (uInt) std::min(outLeft, kMaxChunk);
+        result = inflate(&stream, Z_NO_FLUSH);
+    } while (result == Z_OK && (stream.avail_in == 0 || stream.avail_out == 0));
+
     if (result != Z_STREAM_END) {
         return -1;
     }
     return 0;
 }
 
-int ZipFile::uncompress(const ZipEntry *e, void *out) const noexcept
+/**
+ * 校验读到的数据，需要的话解压到 out。存储的 entry 是直接读进 out 的，in 和 out 相同
+ */
+static int finishEntry(const ZipEntry *e, void *out, const void *in, size_t inLen) noexcept
 {
-    if (e->flag != 0) {
+    uLong crc = 0;
+    if (e->method == COMPRESS_STORE) {
+        crc = crc32_z(crc, (Bytef *) out, inLen);
+    }
+    else if (e->method == COMPRESS_DEFLATE) {
+        uncompressRaw(out, e->unCompressedSize, in, inLen);
+        crc = crc32_z(crc, (Bytef *) out, e->unCompressedSize);
+    }
+
+    if (crc != e->crc32) {
         return -1;
     }
+    return 0;
+}
 
-    uLong crc = 0;
-    fseek(mFile, e->bytesOffset, SEEK_SET);
+int ZipFile::uncompress(const ZipEntry *e, void *out) const noexcept
+{
+    // 大小都以中央目录为准，data descriptor、utf-8 文件名等标志位不影响解压，只有加密的不支持
+    if ((e->flag & FLAG_ENCRYPTED) != 0) {
+        return -1;
+    }
 
     if (e->method == COMPRESS_STORE) {
-        auto consumed = readFully(mFile, out, e->unCompressedSize);
-        crc = crc32(crc, (Bytef *) out, consumed);
+        auto consumed = mReader->read(out, e->unCompressedSize, e->bytesOffset);
+        return finishEntry(e, out, out, consumed);
     }
-    else if (e->method == COMPRESS_DEFLATE) {
+    if (e->method == COMPRESS_DEFLATE) {
         auto in = std::make_unique<char[]>(e->compressedSize);
-        auto inLen = readFully(mFile, in.get(), e->compressedSize);
-        uncompressRaw(out, e->unCompressedSize, in.get(), inLen);
-        crc = crc32(crc, (Bytef *) out, e->unCompressedSize);
+        auto inLen = mReader->read(in.get(), e->compressedSize, e->bytesOffset);
+        return finishEntry(e, out, in.get(), inLen);
     }
+    return finishEntry(e, out, nullptr, 0);
+}
 
-    if (crc != e->crc32) {
+void ZipFile::uncompress(const std::vector<const ZipEntry *> &entries, const std::vector<void *> &buffs,
+                         std::vector<int> *results, size_t threads) const noexcept
+{
+    results->assign(entries.size(), -1);
+
+    // 存储的 entry 直接读进目标缓冲区，压缩的先读到临时缓冲区，解压完就释放
+    std::vector<std::unique_ptr<u1[]>> inputs(entries.size());
+    std::vector<FileReader::Request> requests;
+    std::vector<size_t> owners;     // 请求对应的 entry 下标
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto e = entries[i];
+        if ((e->flag & FLAG_ENCRYPTED) != 0) {
+            continue;
+        }
+        void *dst = buffs[i];
+        size_t size = 0;
+        if (e->method == COMPRESS_STORE) {
+            size = e->unCompressedSize;
+        }
+        else if (e->method == COMPRESS_DEFLATE) {
+            inputs[i] = std::make_unique<u1[]>(e->compressedSize);
+            dst = inputs[i].get();
+            size = e->compressedSize;
+        }
+        requests.push_back({ dst, e->bytesOffset, size, 0 });
+        owners.push_back(i);
+    }
+    if (requests.empty()) {
+        return;
+    }
+
+    if (threads == 0) {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, requests.size());
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::deque<size_t> ready;
+    bool finished = false;
+
+    auto worker = [&]() {
+        while (true) {
+            size_t k;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                cond.wait(guard, [&]() { return !ready.empty() || finished; });
+                if (ready.empty()) {
+                    return;
+                }
+                k = ready.front();
+                ready.pop_front();
+            }
+            size_t i = owners[k];
+            (*results)[i] = finishEntry(entries[i], buffs[i], requests[k].dst, requests[k].result);
+            inputs[i].reset();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back(worker);
+    }
+
+    mReader->readBatch(requests.data(), requests.size(), [&](size_t k) {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.push_back(k);
+        cond.notify_one();
+    });
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        finished = true;
+    }
+    cond.notify_all();
+    for (auto &it : workers) {
+        it.join();
+    }
+}
+
+ZipStream::ZipStream(FILE *file) noexcept : mFile(file), mBuff(std::make_unique<u1[]>(BUFF_SIZE))
+{
+}
+
+size_t ZipStream::fill() noexcept
+{
+    if (mBegin == mEnd) {
+        mBegin = 0;
+        mEnd = fread(mBuff.get(), 1, BUFF_SIZE, mFile);
+    }
+    return mEnd - mBegin;
+}
+
+size_t ZipStream::read(void *dst, size_t size) noexcept
+{
+    size_t consumed = 0;
+    while (consumed < size && fill() > 0) {
+        auto bytes = std::min(size - consumed, mEnd - mBegin);
+        memcpy((u1 *) dst + consumed, mBuff.get() + mBegin, bytes);
+        mBegin += bytes;
+        consumed += bytes;
+    }
+    mOffset += consumed;
+    return consumed;
+}
+
+bool ZipStream::skip(u8 size) noexcept
+{
+    while (size > 0 && fill() > 0) {
+        auto bytes = (size_t) std::min<u8>(size, mEnd - mBegin);
+        mBegin += bytes;
+        mOffset += bytes;
+        size -= bytes;
+    }
+    return size == 0;
+}
+
+int ZipStream::skipSigningBlock(u4 sizeLow) noexcept
+{
+    // apk 签名块：u8 大小 (不含自身)，若干 id-value 对，再重复一次 u8 大小，最后是 16 字节的魔数
+    static constexpr char MAGIC[] = "APK Sig Block 42";
+    static constexpr u8 TRAILER = sizeof(u8) + sizeof(MAGIC) - 1;
+
+    u4 sizeHigh = 0;
+    if (read(&sizeHigh, sizeof(sizeHigh)) != sizeof(sizeHigh)) {
+        return -1;
+    }
+    u8 size = ((u8) sizeHigh << 32) | sizeLow;
+    if (size < TRAILER || !skip(size - TRAILER)) {
+        return -1;
+    }
+
+    u8 sizeAgain = 0;
+    char magic[sizeof(MAGIC) - 1];
+    u4 next = 0;
+    if (read(&sizeAgain, sizeof(sizeAgain)) != sizeof(sizeAgain)
+        || read(magic, sizeof(magic)) != sizeof(magic)
+        || read(&next, sizeof(next)) != sizeof(next)) {
+        return -1;
+    }
+    if (sizeAgain != size || memcmp(magic, MAGIC, sizeof(magic)) != 0
+        || (next != CDE::MAGIC && next != EOCD::MAGIC)) {
+        return -1;
+    }
+    return 1;
+}
+
+int ZipStream::next(const ZipEntry **e) noexcept
+{
+    if (mPending && uncompress(nullptr) != 0) {
         return -1;
     }
+
+    LFH lfh {};
+    auto headerOffset = mOffset;
+    if (read(&lfh.magic, sizeof(lfh.magic)) != sizeof(lfh.magic)) {
+        // 中央目录之前就没有数据了，说明下载或者管道被截断了
+        return -1;
+    }
+    // local entry 之后是 apk 签名块或者中央目录，流式读取到这里就结束了，其它情况都当作出错
+    if (lfh.magic == CDE::MAGIC || lfh.magic == EOCD::MAGIC) {
+        return 1;
+    }
+    if (lfh.magic != LFH::MAGIC) {
+        return skipSigningBlock(lfh.magic);
+    }
+    if (read((u1 *) &lfh + sizeof(lfh.magic), sizeof(LFH) - sizeof(lfh.magic)) != sizeof(LFH) - sizeof(lfh.magic)) {
+        return -1;
+    }
+
+    mEntry = {};
+    mEntry.versionToExtract = lfh.version;
+    mEntry.flag = lfh.flag;
+    mEntry.method = lfh.method;
+    mEntry.mTime = lfh.mTime;
+    mEntry.mDate = lfh.mDate;
+    mEntry.crc32 = lfh.crc32;
+    mEntry.compressedSize = lfh.compressedSize;
+    mEntry.unCompressedSize = lfh.uncompressedSize;
+    mEntry.nameLength = lfh.nameLength;
+    mEntry.extraLength = lfh.extraLength;
+
+    mName.resize(lfh.nameLength);
+    mExtra.resize(lfh.extraLength);
+    if (read(mName.data(), lfh.nameLength) != lfh.nameLength
+        || read(mExtra.data(), lfh.extraLength) != lfh.extraLength) {
+        return -1;
+    }
+
+    // local header 里的 zip64 extra 总是同时带着原始大小和压缩后大小
+    mZip64 = false;
+    BytesInput input(mExtra.data(), mExtra.size());
+    while (input.where() + 4 <= input.length()) {
+        u2 id = 0, size = 0;
+        input >> id >> size;
+        size_t next = input.where() + size;
+        if (id == 0x0001 && size >= 16) {
+            mZip64 = true;
+            input >> mEntry.unCompressedSize >> mEntry.compressedSize;
+        }
+        input.seek(next);
+    }
+
+    mEntry.name = mName.c_str();
+    mEntry.extra = mExtra.data();
+    mEntry.bytesOffset = headerOffset + sizeof(LFH) + lfh.nameLength + lfh.extraLength;
+    mPending = true;
+    *e = &mEntry;
     return 0;
-}
\ No newline at end of file
+}
+
+int ZipStream::inflateEntry(std::vector<u1> *out) noexcept
+{
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return -1;
+    }
+    std::unique_ptr<z_stream, void (*)(z_stream *)> streamGuard(
+            &stream, [](z_stream *p) { inflateEnd(p); });
+
+    // 不知道大小时 (data descriptor) 一边解压一边扩容，只是跳过时解压到临时缓冲区里
+    bool sizeKnown = (mEntry.flag & FLAG_DATA_DESCRIPTOR) == 0;
+    u8 inLeft = sizeKnown ? mEntry.compressedSize : std::numeric_limits<u8>::max();
+    u1 scratch[16 * 1024];
+    size_t produced = 0;
+    if (out != nullptr) {
+        out->resize(sizeKnown ? mEntry.unCompressedSize : std::max<u8>(mEntry.compressedSize * 4, 64 * 1024));
+    }
+
+    int result = Z_OK;
+    while (result != Z_STREAM_END) {
+        if (fill() == 0 || inLeft == 0) {
+            return -1;
+        }
+        auto avail = (size_t) std::min<u8>(inLeft, mEnd - mBegin);
+        stream.next_in = mBuff.get() + mBegin;
+        stream.avail_in = (uInt) avail;
+
+        while (stream.avail_in > 0 && result != Z_STREAM_END) {
+            if (out != nullptr && produced == out->size()) {
+                out->resize(std::max<size_t>(out->size() * 2, 4096));
+            }
+            stream.next_out = out == nullptr ? scratch : out->data() + produced;
+            stream.avail_out = (uInt) std::min<size_t>(
+                    out == nullptr ? sizeof(scratch) : out->size() - produced,
+                    std::numeric_limits<uInt>::max());
+            auto outBefore = stream.avail_out;
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                return -1;
+            }
+            if (out != nullptr) {
+                produced += outBefore - stream.avail_out;
+            }
+        }
+
+        // 解压结束时多读进来的数据要留给下一个 entry
+        auto consumed = avail - stream.avail_in;
+        mBegin += consumed;
+        mOffset += consumed;
+        inLeft -= consumed;
+    }
+    if (out != nullptr) {
+        out->resize(produced);
+    }
+    return 0;
+}
+
+int ZipStream::readDataDescriptor() noexcept
+{
+    static constexpr u4 MAGIC = 0x08074b50;
+
+    u4 value = 0;
+    if (read(&value, sizeof(u4)) != sizeof(u4)) {
+        return -1;
+    }
+    // 签名是可选的
+    if (value == MAGIC && read(&value, sizeof(u4)) != sizeof(u4)) {
+        return -1;
+    }
+    mEntry.crc32 = value;
+
+    if (mZip64) {
+        return read(&mEntry.compressedSize, 8) == 8 && read(&mEntry.unCompressedSize, 8) == 8 ? 0 : -1;
+    }
+    u4 compressedSize = 0, unCompressedSize = 0;
+    if (read(&compressedSize, 4) != 4 || read(&unCompressedSize, 4) != 4) {
+        return -1;
+    }
+    mEntry.compressedSize = compressedSize;
+    mEntry.unCompressedSize = unCompressedSize;
+    return 0;
+}
+
+int ZipStream::uncompress(std::vector<u1> *out) noexcept
+{
+    if (!mPending) {
+        return -1;
+    }
+    mPending = false;
+
+    bool hasDescriptor = (mEntry.flag & FLAG_DATA_DESCRIPTOR) != 0;
+    if ((mEntry.flag & FLAG_ENCRYPTED) != 0 && (out != nullptr || hasDescriptor)) {
+        return -1;
+    }
+
+    if (mEntry.method == COMPRESS_DEFLATE && (out != nullptr || hasDescriptor)) {
+        if (inflateEntry(out) != 0) {
+            return -1;
+        }
+    }
+    else if (hasDescriptor) {
+        // 未压缩又带 data descriptor 的 entry 只能靠扫描签名找结尾，不可靠，不支持
+        return -1;
+    }
+    else if (out != nullptr && mEntry.method == COMPRESS_STORE) {
+        out->resize(mEntry.compressedSize);
+        if (read(out->data(), out->size()) != out->size()) {
+            return -1;
+        }
+    }
+    else if (out != nullptr || !skip(mEntry.compressedSize)) {
+        return -1;
+    }
+
+    if (hasDescriptor && readDataDescriptor() != 0) {
+        return -1;
+    }
+    if (out != nullptr && crc32_z(0, out->data(), out->size()) != mEntry.crc32) {
+        return -1;
+    }
+    return 0;
+}
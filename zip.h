@@ -3,6 +3,11 @@
 #define ZIP_H
 
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "reader.h"
 #include "types.h"
 
 enum CompressMethod
@@ -11,6 +16,12 @@ enum CompressMethod
     COMPRESS_DEFLATE = 8,
 };
 
+enum EntryFlag
+{
+    FLAG_ENCRYPTED = 0x0001,
+    FLAG_DATA_DESCRIPTOR = 0x0008,
+};
+
 struct ZipEntry
 {
     u2 versionMadeBy;
@@ -20,15 +31,15 @@ struct ZipEntry
     u2 mTime;
     u2 mDate;
     u4 crc32;
-    u4 compressedSize;
-    u4 unCompressedSize;
+    u8 compressedSize;      // zip64 时来自 extra 字段
+    u8 unCompressedSize;    // zip64 时来自 extra 字段
     u2 nameLength;
     u2 extraLength;
     u2 commentLength;
 //    u2 diskNumberStart;
 //    u2 internalAttributes;
 //    u4 externalAttributes;
-    u4 bytesOffset;
+    u8 bytesOffset;
 
     const char *name;
     const void *extra;
@@ -40,9 +51,11 @@ class ZipFile
 private:
     size_t mSize = 0;
     ZipEntry *mEntries = nullptr;
-    FILE *mFile = nullptr;
+    std::shared_ptr<FileReader> mReader;    // 嵌套的未压缩 zip 和外层共用同一个 reader
     const char *mComment = nullptr;
 
+    int parse(u8 base, u8 length) noexcept;
+
 public:
     explicit ZipFile() = default;
     ~ZipFile() noexcept { close(); }
@@ -50,7 +63,17 @@ public:
     ZipFile(const ZipFile&) = delete;
     ZipFile& operator=(const ZipFile &) = delete;
 
-    int open(const char *path) noexcept;
+    int open(const char *path, IoBackend backend = IO_AUTO) noexcept;
+
+    /**
+     * 打开嵌在另一个 zip 里、未压缩存储的 zip (比如 .apks 里的 apk)，offset 和 length 描述它在外层文件里的范围
+     */
+    int open(const ZipFile &outer, u8 offset, u8 length) noexcept;
+
+    /**
+     * 打开内存里的 zip，调用者需要保证 data 在 ZipFile 关闭前一直有效
+     */
+    int open(const void *data, size_t length) noexcept;
 
     void close() noexcept;
 
@@ -67,6 +90,64 @@ public:
     int uncompress(size_t index, void *buff) const noexcept;
 
     int uncompress(const ZipEntry *e, void *buff) const noexcept;
+
+    /**
+     * 批量解压：所有 entry 的压缩数据作为一批读请求同时提交，
+     * 每读完一个就交给解压线程，读和解压重叠进行。results[i] 是第 i 个 entry 的解压结果
+     */
+    void uncompress(const std::vector<const ZipEntry *> &entries, const std::vector<void *> &buffs,
+                    std::vector<int> *results, size_t threads = 0) const noexcept;
+};
+
+/**
+ * 只能向前读的 zip，用于从管道、标准输入读取：不依赖末尾的中央目录，
+ * 而是依次解析每个 entry 的 local file header，数据流过时就地解压
+ */
+class ZipStream
+{
+private:
+    static constexpr size_t BUFF_SIZE = 64 * 1024;
+
+    FILE *mFile;
+    std::unique_ptr<u1[]> mBuff;
+    size_t mBegin = 0;
+    size_t mEnd = 0;
+    u8 mOffset = 0;         // 已经消耗的字节数
+
+    ZipEntry mEntry {};
+    std::string mName;
+    std::vector<u1> mExtra;
+    bool mZip64 = false;
+    bool mPending = false;  // 当前 entry 的数据还没有被读过
+
+    size_t fill() noexcept;
+    size_t read(void *dst, size_t size) noexcept;
+    bool skip(u8 size) noexcept;
+    int inflateEntry(std::vector<u1> *out) noexcept;
+    int readDataDescriptor() noexcept;
+
+    /**
+     * 跳过 apk 签名块并确认后面紧跟着中央目录，sizeLow 是已经读出来的大小字段的低 32 位
+     */
+    int skipSigningBlock(u4 sizeLow) noexcept;
+
+public:
+    explicit ZipStream(FILE *file) noexcept;
+    ~ZipStream() noexcept = default;
+
+    NO_COPY(ZipStream)
+
+    /**
+     * 读取下一个 entry 的 local file header，上一个 entry 没有解压时会被跳过。
+     * 返回 1 表示没有更多的 entry (遇到了签名块或者中央目录)，出错或者数据被截断时返回 -1。
+     * 带 data descriptor 的 entry 在解压前 crc 和大小都是 0
+     */
+    int next(const ZipEntry **e) noexcept;
+
+    /**
+     * 解压当前 entry，out 为 nullptr 时只是跳过
+     */
+    int uncompress(std::vector<u1> *out) noexcept;
 };
 
 #endif // ZIP_H
\ No newline at end of file